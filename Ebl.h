@@ -0,0 +1,71 @@
+// Ebl.h: an intrusive API for embedded crit-bit tries.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#ifndef Ebl_h
+#define Ebl_h
+
+// An embedded lookup structure does not allocate any memory: each
+// object in the tree contains an Enode, which holds the object's key
+// pointer and one crit-bit branch, and the tree is made out of these
+// branches. See blog-2015-10-07.md for how it works, including Simon
+// Tatham's proof that the branches do not need parent pointers. So
+// adding or removing an object cannot fail, and a tree costs exactly
+// three words per object plus the key pointer.
+//
+// An object can be in as many trees as it has Enode members, and in
+// at most one tree per Enode. Keys are '\0' terminated strings and the
+// length arguments are a hint. The key must not change while the
+// object is in a tree.
+//
+typedef struct Enode {
+	const char *key;
+	void *twig[2];
+	size_t index;
+} Enode;
+
+// A tree is initialized empty by setting its root to NULL. It is a
+// struct rather than a pointer because the root is updated in place.
+//
+typedef struct Etree {
+	void *root;
+} Etree;
+
+// Get a pointer to the object containing an Enode. You need to include
+// <stddef.h> to use this.
+//
+#define Eobject(type, member, node) \
+	((type *)(void *)((char *)(node) - offsetof(type, member)))
+
+// Find the node with the given key. Returns NULL if the key is not in
+// the tree.
+//
+Enode *Eget(Etree *tree, const char *key, size_t klen);
+
+// Add a node to the tree. The node's key must already be set. Returns
+// the node in the tree with that key, which is the new node unless
+// there was already a node with the same key; in that case the tree
+// is unchanged.
+//
+Enode *Eadd(Etree *tree, Enode *node);
+
+// Remove the node with the given key from the tree and return it.
+// Returns NULL if the key is not in the tree.
+//
+Enode *Edel(Etree *tree, const char *key, size_t klen);
+
+// Find the node that follows the given node in lexicographic order of
+// their keys, or the first node if the argument is NULL. The node must
+// be in the tree. Returns NULL when there are no more nodes.
+//
+Enode *Enext(Etree *tree, Enode *node);
+
+// Debugging
+//
+void Edump(Etree *tree);
+void Esize(Etree *tree,
+    size_t *rsize, size_t *rdepth, size_t *rbranches, size_t *rleaves);
+
+#endif // Ebl_h
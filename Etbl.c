@@ -0,0 +1,135 @@
+// Etbl.c: tables implemented with embedded crit-bit tries.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+// This implements the Tbl.h API on top of Ebl.h so that the embedded
+// trie can be tested and benchmarked like the other tables. Each entry
+// is an allocated item containing an Enode and the value; a real user
+// of Ebl.h would put the Enode in its own objects and allocate nothing.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Tbl.h"
+#include "Ebl.h"
+
+typedef struct Eitem {
+	Enode node;
+	void *val;
+} Eitem;
+
+struct Tbl {
+	Etree tree;
+};
+
+static inline Eitem *
+item(Enode *n) {
+	return(Eobject(Eitem, node, n));
+}
+
+bool
+Tgetkv(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
+	if(tbl == NULL)
+		return(false);
+	Enode *n = Eget(&tbl->tree, key, len);
+	if(n == NULL)
+		return(false);
+	*pkey = n->key;
+	*pval = item(n)->val;
+	return(true);
+}
+
+bool
+Tnextl(Tbl *tbl, const char **pkey, size_t *plen, void **pval) {
+	Enode *n = NULL;
+	if(tbl != NULL && *pkey != NULL)
+		n = Eget(&tbl->tree, *pkey, *plen);
+	if(tbl != NULL && (*pkey == NULL || n != NULL))
+		n = Enext(&tbl->tree, n);
+	if(n == NULL) {
+		*pkey = NULL;
+		*plen = 0;
+		return(false);
+	}
+	*pkey = n->key;
+	*plen = strlen(n->key);
+	*pval = item(n)->val;
+	return(true);
+}
+
+void
+Tfree(Tbl *tbl) {
+	if(tbl == NULL)
+		return;
+	// The items hold the tree together, so remove each one before
+	// freeing it.
+	Enode *n;
+	while((n = Enext(&tbl->tree, NULL)) != NULL) {
+		Edel(&tbl->tree, n->key, strlen(n->key));
+		free(item(n));
+	}
+	free(tbl);
+}
+
+Tbl *
+Tdelkv(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
+	if(tbl == NULL)
+		return(NULL);
+	Enode *n = Edel(&tbl->tree, key, len);
+	if(n == NULL)
+		return(tbl);
+	*pkey = n->key;
+	*pval = item(n)->val;
+	free(item(n));
+	if(tbl->tree.root == NULL) {
+		free(tbl);
+		return(NULL);
+	}
+	return(tbl);
+}
+
+Tbl *
+Tsetl(Tbl *tbl, const char *key, size_t len, void *val) {
+	if(val == NULL)
+		return(Tdell(tbl, key, len));
+	if(tbl == NULL) {
+		tbl = malloc(sizeof(*tbl));
+		if(tbl == NULL) return(NULL);
+		tbl->tree.root = NULL;
+	}
+	Enode *n = Eget(&tbl->tree, key, len);
+	if(n != NULL) {
+		item(n)->val = val;
+		return(tbl);
+	}
+	Eitem *it = malloc(sizeof(*it));
+	if(it == NULL) return(NULL);
+	it->node.key = key;
+	it->val = val;
+	Eadd(&tbl->tree, &it->node);
+	return(tbl);
+}
+
+void
+Tdump(Tbl *tbl) {
+	printf("Tdump root %p\n", tbl);
+	if(tbl != NULL)
+		Edump(&tbl->tree);
+}
+
+void
+Tsize(Tbl *tbl, const char **rtype,
+    size_t *rsize, size_t *rdepth, size_t *rbranches, size_t *rleaves) {
+	*rtype = "eb";
+	*rsize = *rdepth = *rbranches = *rleaves = 0;
+	if(tbl == NULL)
+		return;
+	Esize(&tbl->tree, rsize, rdepth, rbranches, rleaves);
+	*rsize = sizeof(*tbl) + *rleaves * sizeof(Eitem);
+}
@@ -0,0 +1,61 @@
+// Ibl.h: an abstract API for tables with 64 bit integer keys.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#ifndef Ibl_h
+#define Ibl_h
+
+// This is a cut-down version of Tbl.h for keys that are fixed-width
+// integers, so there are no key pointers or lengths. Keys are ordered
+// as unsigned numbers, which is the same as the order of their
+// big-endian byte strings. Smaller integer types can be widened.
+//
+// A table is represented by a pointer to this incomplete struct type.
+// You initialize an empty table by setting the pointer to NULL.
+//
+typedef struct Ibl Ibl;
+
+// Get the value associated with a key.
+// Returns NULL if the key is not in the Table.
+//
+void *Iget(Ibl *tbl, uint64_t key);
+
+// Returns false if the key is not found, otherwise returns true and
+// sets *rval to the table's value pointer.
+//
+bool Igetkv(Ibl *tbl, uint64_t key, void **rval);
+
+// Associate a key with a value in a table. Returns a new pointer to
+// the modified table. If there is an error it sets errno and returns
+// NULL. To delete a key, set its value to NULL. When the last key is
+// deleted, Iset() returns NULL without setting errno. The value is
+// borrowed not copied.
+//
+// Errors:
+// EINVAL - value pointer is not word-aligned
+// ENOMEM - allocation failed
+//
+Ibl *Iset(Ibl *tbl, uint64_t key, void *value);
+Ibl *Idel(Ibl *tbl, uint64_t key);
+
+// Deletes an entry from the table as above, and sets *rval to the
+// removed value pointer.
+//
+Ibl *Idelkv(Ibl *tbl, uint64_t key, void **rval);
+
+// Find the first item in the table whose key is greater than or equal
+// to *pkey, and update *pkey and *pvalue. Returns false if there is no
+// such item. To iterate over the whole table, start with *pkey = 0 and
+// add one to the key after each item (stopping at UINT64_MAX).
+//
+bool Inext(Ibl *tbl, uint64_t *pkey, void **pvalue);
+
+// Debugging
+//
+void Idump(Ibl *tbl);
+void Isize(Ibl *tbl, const char **rtype,
+    size_t *rsize, size_t *rdepth, size_t *rbranches, size_t *rleaves);
+
+#endif // Ibl_h
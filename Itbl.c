@@ -0,0 +1,117 @@
+// Itbl.c: integer tables implemented on top of string tables.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+// This is the obvious way to use a Tbl.h implementation for integer
+// keys: format each key as a fixed-width hexadecimal string, which
+// sorts the same as the numbers. The table owns the key strings. It
+// is here as a baseline for the it trie in the integer benchmarks.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Tbl.h"
+#include "Ibl.h"
+
+#define KEYLEN 16
+
+static void
+format(char *buf, uint64_t key) {
+	snprintf(buf, KEYLEN + 1, "%016llx", (unsigned long long)key);
+}
+
+bool
+Igetkv(Ibl *tbl, uint64_t key, void **pval) {
+	char buf[KEYLEN + 1];
+	const char *rkey = NULL;
+	format(buf, key);
+	return(Tgetkv((Tbl *)tbl, buf, KEYLEN, &rkey, pval));
+}
+
+void *
+Iget(Ibl *tbl, uint64_t key) {
+	void *val = NULL;
+	if(Igetkv(tbl, key, &val))
+		return(val);
+	else
+		return(NULL);
+}
+
+Ibl *
+Idelkv(Ibl *tbl, uint64_t key, void **pval) {
+	char buf[KEYLEN + 1];
+	const char *rkey = NULL;
+	format(buf, key);
+	tbl = (Ibl *)Tdelkv((Tbl *)tbl, buf, KEYLEN, &rkey, pval);
+	free((char *)rkey);
+	return(tbl);
+}
+
+Ibl *
+Idel(Ibl *tbl, uint64_t key) {
+	void *val = NULL;
+	return(Idelkv(tbl, key, &val));
+}
+
+Ibl *
+Iset(Ibl *tbl, uint64_t key, void *val) {
+	if(val == NULL)
+		return(Idel(tbl, key));
+	char buf[KEYLEN + 1];
+	const char *rkey = NULL;
+	void *rval = NULL;
+	format(buf, key);
+	// Re-use the existing key string if there is one.
+	if(Tgetkv((Tbl *)tbl, buf, KEYLEN, &rkey, &rval))
+		return((Ibl *)Tsetl((Tbl *)tbl, rkey, KEYLEN, val));
+	char *copy = strdup(buf);
+	if(copy == NULL)
+		return(NULL);
+	Tbl *t = Tsetl((Tbl *)tbl, copy, KEYLEN, val);
+	if(t == NULL)
+		free(copy);
+	return((Ibl *)t);
+}
+
+bool
+Inext(Ibl *tbl, uint64_t *pkey, void **pval) {
+	if(tbl == NULL)
+		return(false);
+	char buf[KEYLEN + 1];
+	const char *rkey = NULL;
+	format(buf, *pkey);
+	if(Tgetkv((Tbl *)tbl, buf, KEYLEN, &rkey, pval))
+		return(true);
+	// Tnextl() needs a key that is present in the table, so
+	// temporarily insert the one we are looking for.
+	static uint64_t placeholder;
+	Tbl *t = Tsetl((Tbl *)tbl, buf, KEYLEN, &placeholder);
+	if(t == NULL)
+		return(false);
+	size_t len = KEYLEN;
+	rkey = buf;
+	bool found = Tnextl(t, &rkey, &len, pval);
+	if(found)
+		*pkey = strtoull(rkey, NULL, 16);
+	// The table was not empty, so this leaves it where it was.
+	Tdell(t, buf, KEYLEN);
+	return(found);
+}
+
+void
+Idump(Ibl *tbl) {
+	Tdump((Tbl *)tbl);
+}
+
+void
+Isize(Ibl *tbl, const char **rtype,
+    size_t *rsize, size_t *rdepth, size_t *rbranches, size_t *rleaves) {
+	Tsize((Tbl *)tbl, rtype, rsize, rdepth, rbranches, rleaves);
+	// Include the key strings, which the table owns.
+	*rsize += *rleaves * (KEYLEN + 1);
+}
@@ -0,0 +1,216 @@
+// Rhash.c: prefix tables implemented with a hash table per length.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+// This is the naive way to do longest prefix match: keep a separate
+// exact-match table for each prefix length, and try each length that
+// has any prefixes, from the longest down. It is here as a baseline
+// for the rt trie in the prefix table benchmarks.
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Rtbl.h"
+
+typedef unsigned char byte;
+typedef unsigned int uint;
+
+#define ADDRLEN (Rmaxlen / 8)
+
+typedef struct Rentry {
+	struct Rentry *next;
+	byte addr[ADDRLEN];
+	void *val;
+} Rentry;
+
+typedef struct Rhash {
+	Rentry **bucket;
+	size_t count, mask;
+} Rhash;
+
+struct Rtbl {
+	size_t count;
+	Rhash len[Rmaxlen + 1];
+};
+
+// Copy the prefix and clear the bits after it.
+
+static void
+mkkey(byte *key, const void *addr, uint plen) {
+	memset(key, 0, ADDRLEN);
+	memcpy(key, addr, (plen + 7) / 8);
+	if(plen % 8)
+		key[plen / 8] &= (byte)(0xFF00 >> (plen % 8));
+}
+
+static size_t
+hash(const byte *key) {
+	uint64_t h = 0, w;
+	for(uint i = 0; i < ADDRLEN; i += 8) {
+		memcpy(&w, key + i, 8);
+		h = (h ^ w) * 0x9E3779B97F4A7C15ULL;
+		h ^= h >> 29;
+	}
+	return((size_t)h);
+}
+
+static Rentry **
+find(Rhash *h, const byte *key) {
+	Rentry **e = &h->bucket[hash(key) & h->mask];
+	while(*e != NULL && memcmp((*e)->addr, key, ADDRLEN) != 0)
+		e = &(*e)->next;
+	return(e);
+}
+
+void *
+Rget(Rtbl *tbl, const void *addr, uint plen) {
+	if(tbl == NULL || plen > Rmaxlen || tbl->len[plen].count == 0)
+		return(NULL);
+	byte key[ADDRLEN];
+	mkkey(key, addr, plen);
+	Rentry *e = *find(&tbl->len[plen], key);
+	return(e == NULL ? NULL : e->val);
+}
+
+void *
+Rlpm(Rtbl *tbl, const void *addr, uint alen, uint *rplen) {
+	if(tbl == NULL)
+		return(NULL);
+	if(alen > Rmaxlen)
+		alen = Rmaxlen;
+	byte key[ADDRLEN];
+	for(uint plen = alen + 1; plen-- > 0; ) {
+		if(tbl->len[plen].count == 0)
+			continue;
+		mkkey(key, addr, plen);
+		Rentry *e = *find(&tbl->len[plen], key);
+		if(e != NULL) {
+			*rplen = plen;
+			return(e->val);
+		}
+	}
+	return(NULL);
+}
+
+Rtbl *
+Rdel(Rtbl *tbl, const void *addr, uint plen) {
+	if(tbl == NULL || plen > Rmaxlen || tbl->len[plen].count == 0)
+		return(tbl);
+	byte key[ADDRLEN];
+	mkkey(key, addr, plen);
+	Rhash *h = &tbl->len[plen];
+	Rentry **e = find(h, key);
+	if(*e == NULL)
+		return(tbl);
+	Rentry *dead = *e;
+	*e = dead->next;
+	free(dead);
+	if(--h->count == 0) {
+		free(h->bucket);
+		h->bucket = NULL;
+		h->mask = 0;
+	}
+	if(--tbl->count == 0) {
+		free(tbl);
+		return(NULL);
+	}
+	return(tbl);
+}
+
+// Double the size of the bucket array.
+
+static bool
+grow(Rhash *h) {
+	size_t size = h->bucket == NULL ? 8 : (h->mask + 1) * 2;
+	Rentry **bucket = calloc(size, sizeof(*bucket));
+	if(bucket == NULL)
+		return(false);
+	for(size_t i = 0; h->bucket != NULL && i <= h->mask; i++) {
+		while(h->bucket[i] != NULL) {
+			Rentry *e = h->bucket[i];
+			h->bucket[i] = e->next;
+			Rentry **b = &bucket[hash(e->addr) & (size - 1)];
+			e->next = *b;
+			*b = e;
+		}
+	}
+	free(h->bucket);
+	h->bucket = bucket;
+	h->mask = size - 1;
+	return(true);
+}
+
+Rtbl *
+Rset(Rtbl *tbl, const void *addr, uint plen, void *val) {
+	if(plen > Rmaxlen) {
+		errno = EINVAL;
+		return(NULL);
+	}
+	if(val == NULL)
+		return(Rdel(tbl, addr, plen));
+	if(tbl == NULL) {
+		tbl = calloc(1, sizeof(*tbl));
+		if(tbl == NULL) return(NULL);
+	}
+	Rhash *h = &tbl->len[plen];
+	byte key[ADDRLEN];
+	mkkey(key, addr, plen);
+	if(h->count > 0) {
+		Rentry *e = *find(h, key);
+		if(e != NULL) {
+			e->val = val;
+			return(tbl);
+		}
+	}
+	if((h->bucket == NULL || h->count > h->mask) && !grow(h))
+		return(NULL);
+	Rentry *e = malloc(sizeof(*e));
+	if(e == NULL)
+		return(NULL);
+	memcpy(e->addr, key, ADDRLEN);
+	e->val = val;
+	Rentry **b = &h->bucket[hash(key) & h->mask];
+	e->next = *b;
+	*b = e;
+	h->count++;
+	tbl->count++;
+	return(tbl);
+}
+
+void
+Rdump(Rtbl *tbl) {
+	printf("Rdump root %p\n", tbl);
+	if(tbl == NULL)
+		return;
+	for(uint plen = 0; plen <= Rmaxlen; plen++) {
+		Rhash *h = &tbl->len[plen];
+		for(size_t i = 0; h->bucket != NULL && i <= h->mask; i++)
+			for(Rentry *e = h->bucket[i]; e != NULL; e = e->next)
+				printf("Rdump prefix /%u %p\n", plen, e->val);
+	}
+}
+
+void
+Rsize(Rtbl *tbl, const char **rtype,
+    size_t *rsize, size_t *rnodes, size_t *rprefixes) {
+	*rtype = "rh";
+	*rsize = *rnodes = *rprefixes = 0;
+	if(tbl == NULL)
+		return;
+	*rsize = sizeof(*tbl);
+	for(uint plen = 0; plen <= Rmaxlen; plen++) {
+		Rhash *h = &tbl->len[plen];
+		if(h->bucket == NULL)
+			continue;
+		*rnodes += h->mask + 1;
+		*rprefixes += h->count;
+		*rsize += sizeof(Rentry *) * (h->mask + 1) +
+			  sizeof(Rentry) * h->count;
+	}
+}
@@ -0,0 +1,56 @@
+// Rtbl.h: an abstract API for tables of address prefixes.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#ifndef Rtbl_h
+#define Rtbl_h
+
+// This is like Tbl.h but for routing tables, where a key is a prefix
+// of an address: a byte string and a length in bits, most significant
+// bit first, such as an IPv4 or IPv6 address in network byte order.
+// The bits of an address after the prefix length are ignored. Use a
+// separate table for each address family.
+//
+// A table is represented by a pointer to this incomplete struct type.
+// You initialize an empty table by setting the pointer to NULL.
+//
+typedef struct Rtbl Rtbl;
+
+// The maximum prefix length, enough for IPv6.
+//
+#define Rmaxlen 128
+
+// Get the value associated with exactly this prefix.
+// Returns NULL if the prefix is not in the table.
+//
+void *Rget(Rtbl *tbl, const void *addr, unsigned plen);
+
+// Longest prefix match: find the most specific prefix in the table
+// that covers the first alen bits of the address. Returns NULL if
+// there is none, otherwise returns its value and sets *rplen to its
+// length.
+//
+void *Rlpm(Rtbl *tbl, const void *addr, unsigned alen, unsigned *rplen);
+
+// Associate a prefix with a value in a table. Returns a new pointer
+// to the modified table. If there is an error it sets errno and
+// returns NULL. To delete a prefix, set its value to NULL. When the
+// last prefix is deleted, Rset() returns NULL without setting errno.
+// The address is copied and the value is borrowed.
+//
+// Errors:
+// EINVAL - prefix length is greater than Rmaxlen
+// ENOMEM - allocation failed
+//
+Rtbl *Rset(Rtbl *tbl, const void *addr, unsigned plen, void *value);
+Rtbl *Rdel(Rtbl *tbl, const void *addr, unsigned plen);
+
+// Debugging
+//
+void Rdump(Rtbl *tbl);
+void Rsize(Rtbl *tbl, const char **rtype,
+    size_t *rsize, size_t *rnodes, size_t *rprefixes);
+
+#endif // Rtbl_h
@@ -10,6 +10,10 @@
 // A table is represented by a pointer to this incomplete struct type.
 // You initialize an empty table by setting the pointer to NULL.
 //
+// Keys are '\0' terminated strings and the length arguments are a
+// hint, unless the table is compiled with HAVE_BINARY_KEYS; then keys
+// are arbitrary byte strings and the lengths are significant.
+//
 typedef struct Tbl Tbl;
 
 // Get the value associated with a key.
@@ -27,10 +31,16 @@ bool Tgetkv(Tbl *tbl, const char *key, size_t klen, const char **rkey, void **rv
 // the modified table. If there is an error it sets errno and returns
 // NULL. To delete a key, set its value to NULL. When the last key is
 // deleted, Tset() returns NULL without setting errno. The key and
-// value are borrowed not copied.
+// value are borrowed not copied, unless the table is compiled with
+// HAVE_OWNED_KEYS; then the table keeps its own copy of each key, and
+// the key pointers it returns belong to the table and are only valid
+// until the table is next modified.
 //
 // Errors:
 // EINVAL - value pointer is not word-aligned
+//          (or, with HAVE_RAW_VALUES, key pointer is not a
+//          user-space address)
+// EINVAL - key is too long (wp keys are limited to 2^28 - 1 bytes)
 // ENOMEM - allocation failed
 //
 Tbl *Tsetl(Tbl *tbl, const char *key, size_t klen, void *value);
@@ -39,10 +49,16 @@ Tbl *Tdell(Tbl *tbl, const char *key, size_t klen);
 Tbl *Tdel(Tbl *tbl, const char *key);
 
 // Deletes an entry from the table as above, and sets *rkey and *rval
-// to the removed key and value pointers.
+// to the removed key and value pointers. (A table with owned keys has
+// already discarded its copy, so *rkey is set to the key argument.)
 //
 Tbl *Tdelkv(Tbl *tbl, const char *key, size_t klen, const char **rkey, void **rval);
 
+// Free a table and everything it allocated. The values (and borrowed
+// keys) are not freed.
+//
+void Tfree(Tbl *tbl);
+
 // Find the next item in the table. The p... arguments are in/out
 // parameters. To find the first key, pass *pkey=NULL and *pklen=0.
 // For subsequent keys, *pkey must be present in the table and is
@@ -0,0 +1,120 @@
+// Tdns.c: DNS names as table keys.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Tbl.h"
+#include "Tdns.h"
+
+typedef unsigned char byte;
+typedef unsigned int uint;
+
+static inline bool
+isdigit3(const char *p) {
+	return('0' <= p[0] && p[0] <= '9' &&
+	       '0' <= p[1] && p[1] <= '9' &&
+	       '0' <= p[2] && p[2] <= '9');
+}
+
+bool
+Tdnskey(char *key, size_t *plen, const char *name) {
+	// Unescape the labels into a scratch buffer, remembering where
+	// each one is, then copy them to the key in reverse order. The
+	// key has a separator after each label, so its length is the
+	// same as the name in wire format without the root label, which
+	// is at most 254 bytes.
+	char buf[Tdnskeymax];
+	byte pos[Tdnskeymax / 2], len[Tdnskeymax / 2];
+	size_t n = 0, labels = 0;
+	const char *p = name;
+	if(p[0] == '.' && p[1] == '\0')
+		p++;
+	while(*p != '\0') {
+		size_t start = n;
+		while(*p != '\0' && *p != '.') {
+			uint c = (byte)*p++;
+			if(c == '\\' && isdigit3(p)) {
+				c = (uint)(p[0] - '0') * 100 +
+				    (uint)(p[1] - '0') * 10 +
+				    (uint)(p[2] - '0');
+				p += 3;
+				if(c > 255) goto einval;
+			} else if(c == '\\') {
+				if(*p == '\0') goto einval;
+				c = (byte)*p++;
+			}
+			if(c == '\0' || c == Tdnssep)
+				goto einval;
+			if(n - start == 63 || (n + 1) + (labels + 1) > 254)
+				goto emsgsize;
+			if('A' <= c && c <= 'Z')
+				c += 'a' - 'A';
+			buf[n++] = (char)c;
+		}
+		if(n == start)
+			goto einval;
+		pos[labels] = (byte)start;
+		len[labels] = (byte)(n - start);
+		labels++;
+		if(*p == '.')
+			p++;
+	}
+	size_t k = 0;
+	while(labels-- > 0) {
+		memcpy(key + k, buf + pos[labels], len[labels]);
+		k += len[labels];
+		key[k++] = Tdnssep;
+	}
+	key[k] = '\0';
+	*plen = k;
+	return(true);
+einval:
+	errno = EINVAL;
+	return(false);
+emsgsize:
+	errno = EMSGSIZE;
+	return(false);
+}
+
+static size_t
+escape(char *name, byte c) {
+	if(c <= ' ' || c >= 0x7F) {
+		name[0] = '\\';
+		name[1] = (char)('0' + c / 100);
+		name[2] = (char)('0' + c / 10 % 10);
+		name[3] = (char)('0' + c % 10);
+		return(4);
+	}
+	if(strchr(".\\\"()$;@", c) != NULL) {
+		name[0] = '\\';
+		name[1] = (char)c;
+		return(2);
+	}
+	name[0] = (char)c;
+	return(1);
+}
+
+void
+Tdnsname(char *name, const char *key, size_t len) {
+	size_t n = 0;
+	if(len == 0)
+		name[n++] = '.';
+	// Each label ends with a separator, so work backwards from
+	// the end of the key.
+	while(len > 0) {
+		size_t start = len - 1;
+		while(start > 0 && key[start - 1] != Tdnssep)
+			start--;
+		for(size_t i = start; i < len - 1; i++)
+			n += escape(name + n, (byte)key[i]);
+		name[n++] = '.';
+		len = start;
+	}
+	name[n] = '\0';
+}
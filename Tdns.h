@@ -0,0 +1,65 @@
+// Tdns.h: DNS names as table keys.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#ifndef Tdns_h
+#define Tdns_h
+
+// A DNS name is converted to a key by reversing its labels, folding
+// them to lower case, and ending each label with Tdnssep. Lexical
+// order of keys is then the canonical DNS name order (RFC 4034 section
+// 6.1), names in the same zone share a prefix, and a name's ancestors
+// are the prefixes of its key that end with a separator. The root
+// name is the empty key. For example,
+//
+//	www.Example.COM.  ->  "com\1example\1www\1"
+//
+// Labels cannot contain the bytes 0x00 or Tdnssep, because keys are
+// C strings and the separator must sort before any label byte.
+//
+#define Tdnssep '\1'
+
+// A key is at most 255 bytes plus a '\0' terminator, like a name in
+// uncompressed wire format. A name in presentation format can be four
+// times longer, with every byte written as a \DDD escape.
+//
+#define Tdnskeymax 256
+#define Tdnsnamemax 1024
+
+// Convert a name in presentation format to a key. A final '.' is
+// optional. Escapes (\X and \DDD) are supported. On success, returns
+// true and sets *plen to the length of the key, which is stored in a
+// buffer of at least Tdnskeymax bytes.
+//
+// Errors:
+// EINVAL - empty label, or a label contains 0x00 or Tdnssep
+// EMSGSIZE - a label is longer than 63 bytes, or the name is
+//            longer than 255 bytes
+//
+bool Tdnskey(char *key, size_t *plen, const char *name);
+
+// Convert a key back to a fully-qualified name in presentation format,
+// in a buffer of at least Tdnsnamemax bytes. Letters are in lower case.
+//
+void Tdnsname(char *name, const char *key, size_t len);
+
+// The following lookups need the table to be a qp trie; the other
+// implementations do not have them.
+
+// Find the closest encloser of a key: the longest key in the table
+// that is the key itself or one of its ancestors. Returns false if
+// there is none. To look for a wildcard, append "*" Tdnssep to the
+// closest encloser's key and use Tgetl().
+//
+bool Tencloser(Tbl *tbl, const char *key, size_t len, const char **rkey, void **rval);
+
+// Find the key itself, or if it is not present the key before it,
+// such as the owner of an NSEC record that covers a missing name.
+// This works for any keys, not just DNS names. Returns false if there
+// is no key less than or equal to the given one.
+//
+bool Tprevl(Tbl *tbl, const char *key, size_t len, const char **rkey, void **rval);
+
+#endif // Tdns_h
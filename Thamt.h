@@ -0,0 +1,32 @@
+// Thamt.h: extra table functions for hash array mapped tries.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#ifndef Thamt_h
+#define Thamt_h
+
+// These functions need the table to be a HAMT (ht and its variants);
+// the other implementations do not have them. Include Tbl.h first.
+
+// Look up a batch of n keys, setting vals[i] to the value of keys[i],
+// or NULL if it is not in the table.
+//
+// The HAMT hashes several keys at once with a SIMD SipHash, then
+// walks their paths in step so that their cache misses overlap.
+//
+void Tgetn(Tbl *tbl, size_t n, const char *const keys[], const size_t klens[], void *vals[]);
+
+// Call fn for each item in the table, in no particular order, until it
+// returns false. Returns false if fn stopped the walk, true otherwise.
+// The table must not be modified during the walk, so a scan that
+// deletes items needs to collect their keys first.
+//
+// A HAMT's keys are in hash order, so Tnextl() has to hash the
+// previous key again for every step; Twalk() does not hash at all.
+//
+typedef bool Twalkfn(void *ctx, const char *key, size_t klen, void *value);
+bool Twalk(Tbl *tbl, Twalkfn *fn, void *ctx);
+
+#endif // Thamt_h
@@ -0,0 +1,71 @@
+// ap-debug.c: ap trie debug support
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Tbl.h"
+#include "ap.h"
+
+static void
+dump_rec(Trie *t, int d) {
+	if(isbranch(t)) {
+		printf("Tdump%*s branch %p %zu/%u\n", d, "", t,
+		    (size_t)t->branch.offset, (uint)t->branch.stride);
+		int dd = (int)windowend(t) / 2;
+		assert(dd > d);
+		for(uint k = 0; k < 1U << t->branch.stride; k++) {
+			if(hastwig(t, k)) {
+				printf("Tdump%*s twig %u\n", d, "", k);
+				dump_rec(twig(t, twigoff(t, k)), dd);
+			}
+		}
+	} else {
+		printf("Tdump%*s leaf %p\n", d, "", t);
+		printf("Tdump%*s leaf key %p %s\n", d, "",
+		       t->leaf.key, t->leaf.key);
+		printf("Tdump%*s leaf val %p\n", d, "",
+		       t->leaf.val);
+	}
+}
+
+void
+Tdump(Tbl *tbl) {
+	printf("Tdump root %p\n", tbl);
+	if(tbl != NULL)
+		dump_rec(&tbl->root, 0);
+}
+
+static void
+size_rec(Trie *t, uint d,
+    size_t *rsize, size_t *rdepth, size_t *rbranches, size_t *rleaves) {
+	*rsize += sizeof(*t);
+	if(isbranch(t)) {
+		*rbranches += 1;
+		// Count the bitmap in front of the twigs as overhead.
+		*rsize += sizeof(Tnode);
+		uint m = twigmax(t);
+		for(uint i = 0; i < m; i++)
+			size_rec(twig(t, i),
+			    d+1, rsize, rdepth, rbranches, rleaves);
+	} else {
+		*rleaves += 1;
+		*rdepth += d;
+	}
+}
+
+void
+Tsize(Tbl *tbl, const char **rtype,
+    size_t *rsize, size_t *rdepth, size_t *rbranches, size_t *rleaves) {
+	*rtype = "ap";
+	*rsize = *rdepth = *rbranches = *rleaves = 0;
+	if(tbl != NULL)
+		size_rec(&tbl->root, 0, rsize, rdepth, rbranches, rleaves);
+}
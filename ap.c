@@ -0,0 +1,332 @@
+// ap.c: tables implemented with adaptive popcount patricia tries.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Tbl.h"
+#include "ap.h"
+
+bool
+Tgetkv(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
+	if(tbl == NULL)
+		return(false);
+	Trie *t = &tbl->root;
+	while(isbranch(t)) {
+		__builtin_prefetch(t->branch.node);
+		uint k = twigchunk(t, key, len);
+		if(!hastwig(t, k))
+			return(false);
+		t = twig(t, twigoff(t, k));
+	}
+	if(strcmp(key, t->leaf.key) != 0)
+		return(false);
+	*pkey = t->leaf.key;
+	*pval = t->leaf.val;
+	return(true);
+}
+
+static bool
+next_rec(Trie *t, const char **pkey, size_t *plen, void **pval) {
+	if(isbranch(t)) {
+		// Recurse to find either this leaf (*pkey != NULL)
+		// or the next one (*pkey == NULL).
+		uint k = *pkey == NULL ? 0 : twigchunk(t, *pkey, *plen);
+		uint s = twigoff(t, k), m = twigmax(t);
+		for(; s < m; s++)
+			if(next_rec(twig(t, s), pkey, plen, pval))
+				return(true);
+		return(false);
+	}
+	// We have found the next leaf.
+	if(*pkey == NULL) {
+		*pkey = t->leaf.key;
+		*plen = strlen(t->leaf.key);
+		*pval = t->leaf.val;
+		return(true);
+	}
+	// We have found this leaf, so start looking for the next one.
+	if(strcmp(*pkey, t->leaf.key) == 0) {
+		*pkey = NULL;
+		*plen = 0;
+		return(false);
+	}
+	// No match.
+	return(false);
+}
+
+bool
+Tnextl(Tbl *tbl, const char **pkey, size_t *plen, void **pval) {
+	if(tbl == NULL) {
+		*pkey = NULL;
+		*plen = 0;
+		return(NULL);
+	}
+	return(next_rec(&tbl->root, pkey, plen, pval));
+}
+
+static void
+free_rec(Trie *t) {
+	if(!isbranch(t))
+		return;
+	uint m = twigmax(t);
+	for(uint i = 0; i < m; i++)
+		free_rec(twig(t, i));
+	free(t->branch.node);
+}
+
+void
+Tfree(Tbl *tbl) {
+	if(tbl == NULL)
+		return;
+	free_rec(&tbl->root);
+	free(tbl);
+}
+
+Tbl *
+Tdelkv(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
+	if(tbl == NULL)
+		return(NULL);
+	Trie *t = &tbl->root, *p = NULL;
+	uint k = 0;
+	while(isbranch(t)) {
+		__builtin_prefetch(t->branch.node);
+		k = twigchunk(t, key, len);
+		if(!hastwig(t, k))
+			return(tbl);
+		p = t; t = twig(t, twigoff(t, k));
+	}
+	if(strcmp(key, t->leaf.key) != 0)
+		return(tbl);
+	*pkey = t->leaf.key;
+	*pval = t->leaf.val;
+	if(p == NULL) {
+		free(tbl);
+		return(NULL);
+	}
+	t = p; p = NULL; // Because t is the usual name
+	uint s = twigoff(t, k), m = twigmax(t);
+	if(m == 2) {
+		// Move the other twig to the parent branch. Its window (if
+		// it is a branch) is still after the grandparent's.
+		Tnode *node = t->branch.node;
+		*t = *twig(t, !s);
+		free(node);
+		return(tbl);
+	}
+	memmove(twig(t, s), twig(t, s+1), sizeof(Trie) * (m - s - 1));
+	t->branch.node->bitmap &= ~(1ULL << k);
+	// We have now correctly removed the twig from the trie, so if
+	// realloc() fails we can ignore it and continue to use the
+	// slightly oversized node.
+	Tnode *node = realloc(t->branch.node, nodesize(m - 1));
+	if(node != NULL) t->branch.node = node;
+	return(tbl);
+}
+
+// Merge the child branches whose windows are exactly the j bits after
+// t's window into t. The other twigs stay as they are, and their new
+// chunk values come from any leaf below them, since every key below a
+// twig agrees on the bits before its window. The twigs stay in order
+// because the old chunk value is the top of the new chunk value.
+
+static void
+merge(Trie *t, uint j, uint count) {
+	uint s = t->branch.stride, m = twigmax(t);
+	size_t end = windowend(t);
+	Tnode *node = malloc(nodesize(count));
+	// If allocation fails we just leave t as it is.
+	if(node == NULL) return;
+	node->bitmap = 0;
+	Tbitmap map = twigmap(t);
+	uint n = 0;
+	for(uint i = 0; i < m; i++) {
+		Trie *c = twig(t, i);
+		uint k = (uint)__builtin_ctzll(map) << j;
+		map &= map - 1;
+		if(isbranch(c) && c->branch.offset == end) {
+			Tbitmap cmap = twigmap(c);
+			uint cm = twigmax(c);
+			for(uint ci = 0; ci < cm; ci++) {
+				uint ck = (uint)__builtin_ctzll(cmap);
+				cmap &= cmap - 1;
+				node->bitmap |= 1ULL << (k | ck);
+				node->twigs[n++] = *twig(c, ci);
+			}
+			free(c->branch.node);
+		} else {
+			Trie *l = c;
+			while(isbranch(l))
+				l = twig(l, 0);
+			const char *lkey = l->leaf.key;
+			uint ck = chunk(lkey, strlen(lkey), end, j);
+			node->bitmap |= 1ULL << (k | ck);
+			node->twigs[n++] = *c;
+		}
+	}
+	assert(n == count);
+	free(t->branch.node);
+	t->branch.node = node;
+	t->branch.stride = s + j;
+}
+
+// Widen t if it would be dense enough, preferring the widest stride.
+// The caller only tries this when t or one of its twigs has at least
+// half of its possible twigs, to avoid scanning sparse branches.
+
+static void
+absorb(Trie *t) {
+	uint s = t->branch.stride, m = twigmax(t);
+	size_t end = windowend(t);
+	for(uint j = Tmaxstride - s; j > 0; j--) {
+		uint count = 0, merged = 0;
+		for(uint i = 0; i < m; i++) {
+			Trie *c = twig(t, i);
+			if(!isbranch(c) || c->branch.offset >= end + j) {
+				count += 1;
+			} else if(c->branch.offset == end &&
+				  c->branch.stride == j) {
+				count += twigmax(c);
+				merged += 1;
+			} else {
+				goto narrower;
+			}
+		}
+		if(merged > 0 && count * 4 >= 1U << (s + j)) {
+			merge(t, j, count);
+			return;
+		}
+	narrower:;
+	}
+}
+
+static inline bool
+dense(Trie *t) {
+	return(twigmax(t) * 2 >= 1U << t->branch.stride);
+}
+
+Tbl *
+Tsetl(Tbl *tbl, const char *key, size_t len, void *val) {
+	// Ensure flag bits are zero.
+	if(((uint64_t)val & 1) != 0) {
+		errno = EINVAL;
+		return(NULL);
+	}
+	if(val == NULL)
+		return(Tdell(tbl, key, len));
+	// First leaf in an empty tbl?
+	if(tbl == NULL) {
+		tbl = malloc(sizeof(*tbl));
+		if(tbl == NULL) return(NULL);
+		tbl->root.leaf.key = key;
+		tbl->root.leaf.val = val;
+		return(tbl);
+	}
+	Trie *t = &tbl->root;
+	// Find the most similar leaf node in the trie, as in qp.c.
+	while(isbranch(t)) {
+		__builtin_prefetch(t->branch.node);
+		uint k = twigchunk(t, key, len);
+		uint i = hastwig(t, k) ? twigoff(t, k) : 0;
+		t = twig(t, i);
+	}
+	// Do the keys differ, and if so, at which bit?
+	const char *tkey = t->leaf.key;
+	size_t i;
+	for(i = 0; key[i] == tkey[i]; i++) {
+		if(key[i] == '\0') {
+			t->leaf.val = val;
+			return(tbl);
+		}
+	}
+	uint x = (byte)key[i] ^ (byte)tkey[i];
+	size_t d = i * 8 + (uint)__builtin_clz(x) - (sizeof(uint) * 8 - 8);
+	// Prepare the new leaf.
+	Trie t1 = { .leaf = { .key = key, .val = val } };
+	// Find where to insert a branch or grow an existing branch.
+	Trie *p = NULL;
+	size_t pend = 0;
+	t = &tbl->root;
+	while(isbranch(t)) {
+		__builtin_prefetch(t->branch.node);
+		if(d < t->branch.offset)
+			goto newbranch;
+		if(d < windowend(t))
+			goto growbranch;
+		uint k = twigchunk(t, key, len);
+		assert(hastwig(t, k));
+		p = t; pend = windowend(t);
+		t = twig(t, twigoff(t, k));
+	}
+newbranch:;
+	// If d is just before t's window, widen t backwards to include
+	// it rather than squeezing a narrow branch in front of t. All the
+	// existing twigs agree on the new bits, so their chunk values all
+	// gain the same prefix, and the new leaf goes at one end.
+	if(isbranch(t) && d + Tnewstride > t->branch.offset &&
+	   windowend(t) - d <= Tmaxstride) {
+		uint j = (uint)(t->branch.offset - d), s = t->branch.stride;
+		uint m = twigmax(t), k = chunk(key, len, d, s + j);
+		uint top = chunk(tkey, strlen(tkey), d, j) << s;
+		Tnode *node = realloc(t->branch.node, nodesize(m + 1));
+		if(node == NULL) return(NULL);
+		t->branch.node = node;
+		node->bitmap <<= top;
+		if(k < top) {
+			memmove(twig(t, 1), twig(t, 0), sizeof(Trie) * m);
+			*twig(t, 0) = t1;
+		} else {
+			*twig(t, m) = t1;
+		}
+		node->bitmap |= 1ULL << k;
+		t->branch.offset = d;
+		t->branch.stride = s + j;
+		return(tbl);
+	}
+	// The new branch's window must include d and fit between the
+	// parent's window and t's window.
+	size_t off = d;
+	uint s = Tnewstride;
+	if(isbranch(t) && d + s > t->branch.offset) {
+		size_t end = t->branch.offset;
+		off = end >= pend + s ? end - s : pend;
+		s = (uint)(end - off);
+	}
+	uint k1 = chunk(key, len, off, s);
+	uint k2 = chunk(tkey, strlen(tkey), off, s);
+	assert(k1 != k2);
+	Tnode *node = malloc(nodesize(2));
+	if(node == NULL) return(NULL);
+	node->bitmap = (1ULL << k1) | (1ULL << k2);
+	Trie t2 = *t; // Save before overwriting.
+	t->branch.node = node;
+	t->branch.isbranch = 1;
+	t->branch.stride = s;
+	t->branch.offset = off;
+	*twig(t, twigoff(t, k1)) = t1;
+	*twig(t, twigoff(t, k2)) = t2;
+	return(tbl);
+growbranch:;
+	uint k = twigchunk(t, key, len);
+	assert(!hastwig(t, k));
+	uint o = twigoff(t, k), m = twigmax(t);
+	node = realloc(t->branch.node, nodesize(m + 1));
+	if(node == NULL) return(NULL);
+	t->branch.node = node;
+	memmove(twig(t, o+1), twig(t, o), sizeof(Trie) * (m - o));
+	*twig(t, o) = t1;
+	node->bitmap |= 1ULL << k;
+	if(dense(t)) {
+		absorb(t);
+		if(p != NULL)
+			absorb(p);
+	}
+	return(tbl);
+}
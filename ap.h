@@ -0,0 +1,133 @@
+// ap.h: tables implemented with adaptive popcount patricia tries.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+// See qp.h for introductory comments about tries.
+//
+// In an ap trie each branch has its own stride. A branch tests a
+// window of the key that starts at any bit offset and is 1 to 6 bits
+// wide, so its bitmap is up to 64 bits. The key's bits are numbered
+// from the most significant bit of the first byte, with zero bits
+// after the key's '\0' terminator.
+//
+// A new branch is 4 bits wide, starting at the first bit where its
+// keys differ, like a qp branch that is not aligned to a nibble. (It
+// can be narrower if it is squeezed between its parent and the branch
+// below it.) When a branch's fanout grows, it tries to absorb the
+// child branches whose windows start just after its own, as in an
+// LC-trie: a branch of width s with children of width j becomes one
+// branch of width s + j <= 6, if the merged branch would have at
+// least a quarter of its possible twigs. So the dense parts of the
+// trie get wide branches and the sparse parts stay 4 bits wide.
+//
+// A leaf is two words, a key and a value. A branch is two words, a
+// pointer and a word with a tag bit, the stride and the offset. As in
+// qp, the tag bit overlaps the bottom bit of the leaf's value, so
+// values must be word-aligned. The 64 bit bitmap is stored in front of
+// the twig array, like a qk branch, so it does not make every node
+// three words wide as in wp.
+//
+// Only C string keys are supported.
+
+typedef unsigned char byte;
+typedef unsigned int uint;
+
+typedef uint64_t Tbitmap;
+
+#define Tmaxstride 6
+#define Tnewstride 4
+
+static inline uint
+popcount(Tbitmap w) {
+	return((uint)__builtin_popcountll(w));
+}
+
+typedef struct Tleaf {
+	const char *key;
+	void *val;
+} Tleaf;
+
+typedef struct Tbranch {
+	struct Tnode *node;
+	uint64_t
+		isbranch : 1,
+		stride : 3,
+		offset : 60;
+} Tbranch;
+
+typedef union Trie {
+	struct Tleaf   leaf;
+	struct Tbranch branch;
+} Trie;
+
+typedef struct Tnode {
+	Tbitmap bitmap;
+	union Trie twigs[];
+} Tnode;
+
+struct Tbl {
+	union Trie root;
+};
+
+static inline bool
+isbranch(Trie *t) {
+	return(t->branch.isbranch);
+}
+
+// Extract the window of s bits at bit offset off from a key of length
+// len. A window covers parts of at most two bytes.
+
+static inline uint
+chunk(const char *key, size_t len, size_t off, uint s) {
+	size_t b = off / 8;
+	uint o = off % 8;
+	if(b > len) return(0);
+	uint w = (uint)(byte)key[b] << 8;
+	if(o + s > 8 && b < len)
+		w |= (byte)key[b+1];
+	return((w >> (16 - s - o)) & ((1U << s) - 1));
+}
+
+static inline uint
+twigchunk(Trie *t, const char *key, size_t len) {
+	return(chunk(key, len, t->branch.offset, t->branch.stride));
+}
+
+// The bit offset just after a branch's window.
+
+static inline size_t
+windowend(Trie *t) {
+	return(t->branch.offset + t->branch.stride);
+}
+
+static inline Tbitmap
+twigmap(Trie *t) {
+	return(t->branch.node->bitmap);
+}
+
+static inline bool
+hastwig(Trie *t, uint k) {
+	return((twigmap(t) >> k) & 1);
+}
+
+static inline uint
+twigoff(Trie *t, uint k) {
+	return(popcount(twigmap(t) & ((1ULL << k) - 1)));
+}
+
+static inline uint
+twigmax(Trie *t) {
+	return(popcount(twigmap(t)));
+}
+
+static inline Trie *
+twig(Trie *t, uint i) {
+	return(&t->branch.node->twigs[i]);
+}
+
+static inline size_t
+nodesize(uint m) {
+	return(sizeof(Tnode) + sizeof(Trie) * m);
+}
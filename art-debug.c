@@ -0,0 +1,83 @@
+// art-debug.c: ART debug support
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Tbl.h"
+#include "art.h"
+
+static void
+dump_leaf(Tleaf *l, int d) {
+	printf("Tdump%*s leaf %p\n", d, "", l);
+	printf("Tdump%*s leaf key %p %.*s\n", d, "",
+	       l->key, (int)l->len, l->key);
+	printf("Tdump%*s leaf val %p\n", d, "", l->val);
+}
+
+static void
+dump_rec(void *p, int d) {
+	if(isleaf(p)) {
+		dump_leaf(toleaf(p), d);
+		return;
+	}
+	Tnode *n = p;
+	printf("Tdump%*s node%u %p prefix %u %.*s\n", d, "",
+	       nodecap(n->type), n, n->prefixlen,
+	       (int)storedprefix(n->prefixlen), n->prefix);
+	if(n->end != NULL)
+		dump_leaf(n->end, d + 1);
+	byte keys[256];
+	void *kids[256];
+	uint m = children(n, keys, kids);
+	for(uint i = 0; i < m; i++) {
+		printf("Tdump%*s child %u\n", d, "", keys[i]);
+		dump_rec(kids[i], d + 1);
+	}
+}
+
+void
+Tdump(Tbl *tbl) {
+	printf("Tdump root %p\n", tbl);
+	if(tbl != NULL)
+		dump_rec(tbl->root, 0);
+}
+
+static void
+size_rec(void *p, size_t d,
+    size_t *rsize, size_t *rdepth, size_t *rbranches, size_t *rleaves) {
+	if(isleaf(p)) {
+		*rsize += sizeof(Tleaf);
+		*rdepth += d;
+		*rleaves += 1;
+		return;
+	}
+	Tnode *n = p;
+	*rsize += nodesize(n->type);
+	*rbranches += 1;
+	if(n->end != NULL)
+		size_rec(leafptr(n->end), d + 1,
+		    rsize, rdepth, rbranches, rleaves);
+	byte keys[256];
+	void *kids[256];
+	uint m = children(n, keys, kids);
+	for(uint i = 0; i < m; i++)
+		size_rec(kids[i], d + 1, rsize, rdepth, rbranches, rleaves);
+}
+
+void
+Tsize(Tbl *tbl, const char **rtype,
+    size_t *rsize, size_t *rdepth, size_t *rbranches, size_t *rleaves) {
+	*rtype = "ar";
+	*rsize = *rdepth = *rbranches = *rleaves = 0;
+	if(tbl != NULL) {
+		*rsize = sizeof(*tbl);
+		size_rec(tbl->root, 0, rsize, rdepth, rbranches, rleaves);
+	}
+}
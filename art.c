@@ -0,0 +1,493 @@
+// art.c: tables implemented with adaptive radix trees.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "Tbl.h"
+#include "art.h"
+
+// Find the child for byte c, or NULL.
+
+static inline void **
+findchild(Tnode *n, byte c) {
+	switch(n->type) {
+	case(N4): {
+		Tnode4 *n4 = (Tnode4 *)n;
+		for(uint i = 0; i < n->count; i++)
+			if(n4->key[i] == c)
+				return(&n4->child[i]);
+		return(NULL);
+	}
+	case(N16): {
+		Tnode16 *n16 = (Tnode16 *)n;
+#ifdef __SSE2__
+		__m128i keys = _mm_loadu_si128((__m128i *)n16->key);
+		__m128i cmp = _mm_cmpeq_epi8(keys, _mm_set1_epi8((char)c));
+		uint mask = (uint)_mm_movemask_epi8(cmp) & ((1U << n->count) - 1);
+		if(mask != 0)
+			return(&n16->child[__builtin_ctz(mask)]);
+#else
+		for(uint i = 0; i < n->count; i++)
+			if(n16->key[i] == c)
+				return(&n16->child[i]);
+#endif
+		return(NULL);
+	}
+	case(N48): {
+		Tnode48 *n48 = (Tnode48 *)n;
+		if(n48->index[c] == 0)
+			return(NULL);
+		return(&n48->child[n48->index[c] - 1]);
+	}
+	default: {
+		Tnode256 *n256 = (Tnode256 *)n;
+		if(n256->child[c] == NULL)
+			return(NULL);
+		return(&n256->child[c]);
+	}
+	}
+}
+
+// Any leaf below a node, to recover the parts of its prefix that are
+// not stored in the node.
+
+static Tleaf *
+anyleaf(void *p) {
+	while(!isleaf(p)) {
+		Tnode *n = p;
+		if(n->end != NULL)
+			return(n->end);
+		byte keys[256];
+		void *kids[256];
+		children(n, keys, kids);
+		p = kids[0];
+	}
+	return(toleaf(p));
+}
+
+// Add a child to a node that has room for it, keeping Node4 and
+// Node16 sorted.
+
+static void
+put(Tnode *n, byte c, void *child) {
+	switch(n->type) {
+	case(N4):
+	case(N16): {
+		byte *key;
+		void **kid;
+		if(n->type == N4) {
+			key = ((Tnode4 *)n)->key;
+			kid = ((Tnode4 *)n)->child;
+		} else {
+			key = ((Tnode16 *)n)->key;
+			kid = ((Tnode16 *)n)->child;
+		}
+		uint i = 0;
+		while(i < n->count && key[i] < c)
+			i++;
+		memmove(key + i + 1, key + i, n->count - i);
+		memmove(kid + i + 1, kid + i, sizeof(void *) * (n->count - i));
+		key[i] = c;
+		kid[i] = child;
+		break;
+	}
+	case(N48): {
+		Tnode48 *n48 = (Tnode48 *)n;
+		uint i = 0;
+		while(n48->child[i] != NULL)
+			i++;
+		n48->child[i] = child;
+		n48->index[c] = (byte)(i + 1);
+		break;
+	}
+	default:
+		((Tnode256 *)n)->child[c] = child;
+		break;
+	}
+	n->count++;
+}
+
+static Tnode *
+newnode(byte type) {
+	Tnode *n = calloc(1, nodesize(type));
+	if(n == NULL) return(NULL);
+	n->type = type;
+	return(n);
+}
+
+static void
+setprefix(Tnode *n, const void *prefix, size_t len) {
+	n->prefixlen = (uint32_t)len;
+	memmove(n->prefix, prefix, storedprefix(len));
+}
+
+// Copy a node into a new node of a different size.
+
+static Tnode *
+rebuild(Tnode *n, byte type) {
+	Tnode *nn = newnode(type);
+	if(nn == NULL) return(NULL);
+	nn->end = n->end;
+	setprefix(nn, n->prefix, n->prefixlen);
+	byte keys[256];
+	void *kids[256];
+	uint m = children(n, keys, kids);
+	for(uint i = 0; i < m; i++)
+		put(nn, keys[i], kids[i]);
+	free(n);
+	return(nn);
+}
+
+// Add a child, growing the node if it is full. *ref is the parent's
+// pointer to the node.
+
+static bool
+addchild(void **ref, Tnode *n, byte c, void *child) {
+	if(n->count == nodecap(n->type)) {
+		n = rebuild(n, n->type + 1);
+		if(n == NULL) return(false);
+		*ref = n;
+	}
+	put(n, c, child);
+	return(true);
+}
+
+static void
+removechild(Tnode *n, byte c) {
+	switch(n->type) {
+	case(N4):
+	case(N16): {
+		byte *key;
+		void **kid;
+		if(n->type == N4) {
+			key = ((Tnode4 *)n)->key;
+			kid = ((Tnode4 *)n)->child;
+		} else {
+			key = ((Tnode16 *)n)->key;
+			kid = ((Tnode16 *)n)->child;
+		}
+		uint i = 0;
+		while(key[i] != c)
+			i++;
+		memmove(key + i, key + i + 1, n->count - i - 1);
+		memmove(kid + i, kid + i + 1, sizeof(void *) * (n->count - i - 1));
+		break;
+	}
+	case(N48): {
+		Tnode48 *n48 = (Tnode48 *)n;
+		n48->child[n48->index[c] - 1] = NULL;
+		n48->index[c] = 0;
+		break;
+	}
+	default:
+		((Tnode256 *)n)->child[c] = NULL;
+		break;
+	}
+	n->count--;
+}
+
+// After a removal, replace a Node4 that has only one thing left with
+// that thing, or shrink a bigger node that is about a quarter full.
+
+static void
+shrink(void **ref, Tnode *n) {
+	if(n->type == N4 && n->count + (n->end != NULL) == 1) {
+		if(n->end != NULL) {
+			*ref = leafptr(n->end);
+		} else if(isleaf(((Tnode4 *)n)->child[0])) {
+			*ref = ((Tnode4 *)n)->child[0];
+		} else {
+			// Concatenate this node's prefix, the child's key
+			// byte, and the child's prefix.
+			Tnode *cn = ((Tnode4 *)n)->child[0];
+			byte buf[Tmaxprefix];
+			size_t len = storedprefix(n->prefixlen);
+			memcpy(buf, n->prefix, len);
+			if(len < Tmaxprefix)
+				buf[len++] = ((Tnode4 *)n)->key[0];
+			size_t more = storedprefix(cn->prefixlen);
+			if(more > Tmaxprefix - len)
+				more = Tmaxprefix - len;
+			memcpy(buf + len, cn->prefix, more);
+			len = n->prefixlen + 1 + cn->prefixlen;
+			setprefix(cn, buf, len);
+			*ref = cn;
+		}
+		free(n);
+		return;
+	}
+	static const uint16_t low[] = { 0, 3, 12, 36 };
+	if(n->count <= low[n->type]) {
+		// If this fails we can carry on with the bigger node.
+		Tnode *nn = rebuild(n, n->type - 1);
+		if(nn != NULL) *ref = nn;
+	}
+}
+
+bool
+Tgetkv(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
+	if(tbl == NULL)
+		return(false);
+	void *p = tbl->root;
+	size_t d = 0;
+	while(!isleaf(p)) {
+		Tnode *n = p;
+		if(n->prefixlen != 0) {
+			if(len - d < n->prefixlen)
+				return(false);
+			if(memcmp(key + d, n->prefix,
+				  storedprefix(n->prefixlen)) != 0)
+				return(false);
+			d += n->prefixlen;
+		}
+		if(d == len) {
+			if(n->end == NULL)
+				return(false);
+			p = leafptr(n->end);
+			break;
+		}
+		void **c = findchild(n, (byte)key[d]);
+		if(c == NULL)
+			return(false);
+		p = *c;
+		d++;
+	}
+	Tleaf *l = toleaf(p);
+	if(!leafmatch(l, key, len))
+		return(false);
+	*pkey = l->key;
+	*pval = l->val;
+	return(true);
+}
+
+static bool
+next_rec(void *p, size_t d, const char *key, size_t len,
+    const char **pkey, size_t *plen, void **pval) {
+	if(isleaf(p)) {
+		// We are either looking for the first leaf, or we
+		// have found this key so we need to keep looking.
+		if(key != NULL)
+			return(false);
+		Tleaf *l = toleaf(p);
+		*pkey = l->key;
+		*plen = l->len;
+		*pval = l->val;
+		return(true);
+	}
+	Tnode *n = p;
+	d += n->prefixlen;
+	byte keys[256];
+	void *kids[256];
+	uint m = children(n, keys, kids), i = 0;
+	if(key == NULL) {
+		if(n->end != NULL)
+			return(next_rec(leafptr(n->end), d, NULL, 0,
+					pkey, plen, pval));
+	} else if(d < len) {
+		byte c = (byte)key[d];
+		while(i < m && keys[i] < c)
+			i++;
+		if(i < m && keys[i] == c &&
+		   next_rec(kids[i++], d + 1, key, len, pkey, plen, pval))
+			return(true);
+	}
+	// The key ended at this node, or it is before all the rest.
+	for(; i < m; i++)
+		if(next_rec(kids[i], d + 1, NULL, 0, pkey, plen, pval))
+			return(true);
+	return(false);
+}
+
+bool
+Tnextl(Tbl *tbl, const char **pkey, size_t *plen, void **pval) {
+	if(tbl != NULL &&
+	   next_rec(tbl->root, 0, *pkey, *plen, pkey, plen, pval))
+		return(true);
+	*pkey = NULL;
+	*plen = 0;
+	return(false);
+}
+
+static void
+free_rec(void *p) {
+	if(isleaf(p)) {
+		free(toleaf(p));
+		return;
+	}
+	Tnode *n = p;
+	byte keys[256];
+	void *kids[256];
+	uint m = children(n, keys, kids);
+	for(uint i = 0; i < m; i++)
+		free_rec(kids[i]);
+	free(n->end);
+	free(n);
+}
+
+void
+Tfree(Tbl *tbl) {
+	if(tbl == NULL)
+		return;
+	free_rec(tbl->root);
+	free(tbl);
+}
+
+Tbl *
+Tdelkv(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
+	if(tbl == NULL)
+		return(NULL);
+	void **ref = &tbl->root, **nref = NULL;
+	Tnode *n = NULL;
+	size_t d = 0;
+	while(!isleaf(*ref)) {
+		n = *ref;
+		nref = ref;
+		if(n->prefixlen != 0) {
+			if(len - d < n->prefixlen)
+				return(tbl);
+			if(memcmp(key + d, n->prefix,
+				  storedprefix(n->prefixlen)) != 0)
+				return(tbl);
+			d += n->prefixlen;
+		}
+		if(d == len) {
+			if(n->end == NULL)
+				return(tbl);
+			ref = NULL;
+			break;
+		}
+		ref = findchild(n, (byte)key[d]);
+		if(ref == NULL)
+			return(tbl);
+		d++;
+	}
+	Tleaf *l = ref == NULL ? n->end : toleaf(*ref);
+	if(!leafmatch(l, key, len))
+		return(tbl);
+	*pkey = l->key;
+	*pval = l->val;
+	free(l);
+	if(n == NULL) {
+		free(tbl);
+		return(NULL);
+	}
+	if(ref == NULL)
+		n->end = NULL;
+	else
+		removechild(n, (byte)key[d - 1]);
+	shrink(nref, n);
+	return(tbl);
+}
+
+Tbl *
+Tsetl(Tbl *tbl, const char *key, size_t len, void *val) {
+	if(val == NULL)
+		return(Tdell(tbl, key, len));
+	Tleaf *nl = malloc(sizeof(*nl));
+	if(nl == NULL) return(NULL);
+	nl->key = key;
+	nl->len = len;
+	nl->val = val;
+	// First leaf in an empty tbl?
+	if(tbl == NULL) {
+		tbl = malloc(sizeof(*tbl));
+		if(tbl == NULL) goto nomem;
+		tbl->root = leafptr(nl);
+		return(tbl);
+	}
+	void **ref = &tbl->root;
+	size_t d = 0;
+	while(!isleaf(*ref)) {
+		Tnode *n = *ref;
+		if(n->prefixlen != 0) {
+			// Find how much of the prefix matches, getting
+			// the unstored part from a leaf.
+			size_t max = len - d < n->prefixlen
+				? len - d : n->prefixlen;
+			size_t stored = storedprefix(n->prefixlen);
+			const byte *full = n->prefix;
+			size_t m = 0;
+			while(m < max && m < stored && full[m] == (byte)key[d+m])
+				m++;
+			if(m == stored && m < max) {
+				full = (const byte *)anyleaf(n)->key + d;
+				while(m < max && full[m] == (byte)key[d+m])
+					m++;
+			}
+			if(m < n->prefixlen) {
+				// Split the prefix with a new Node4. The
+				// node's new prefix might need bytes that
+				// were not stored.
+				Tnode *nn = newnode(N4);
+				if(nn == NULL) goto nomem;
+				setprefix(nn, key + d, m);
+				if(n->prefixlen > Tmaxprefix)
+					full = (const byte *)anyleaf(n)->key + d;
+				byte c = full[m];
+				setprefix(n, full + m + 1, n->prefixlen - m - 1);
+				put(nn, c, n);
+				if(d + m == len)
+					nn->end = nl;
+				else
+					put(nn, (byte)key[d+m], leafptr(nl));
+				*ref = nn;
+				return(tbl);
+			}
+			d += n->prefixlen;
+		}
+		if(d == len) {
+			if(n->end == NULL) {
+				n->end = nl;
+				return(tbl);
+			}
+			n->end->val = val;
+			free(nl);
+			return(tbl);
+		}
+		void **c = findchild(n, (byte)key[d]);
+		if(c == NULL) {
+			if(!addchild(ref, n, (byte)key[d], leafptr(nl)))
+				goto nomem;
+			return(tbl);
+		}
+		ref = c;
+		d++;
+	}
+	Tleaf *l = toleaf(*ref);
+	if(leafmatch(l, key, len)) {
+		l->val = val;
+		free(nl);
+		return(tbl);
+	}
+	// Replace the leaf with a Node4 holding both leaves, whose
+	// prefix is the rest of their common prefix.
+	size_t i = d, max = len < l->len ? len : l->len;
+	while(i < max && key[i] == l->key[i])
+		i++;
+	Tnode *nn = newnode(N4);
+	if(nn == NULL) goto nomem;
+	setprefix(nn, key + d, i - d);
+	if(i == len)
+		nn->end = nl;
+	else
+		put(nn, (byte)key[i], leafptr(nl));
+	if(i == l->len)
+		nn->end = l;
+	else
+		put(nn, (byte)l->key[i], leafptr(l));
+	*ref = nn;
+	return(tbl);
+nomem:
+	free(nl);
+	return(NULL);
+}
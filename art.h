@@ -0,0 +1,155 @@
+// art.h: tables implemented with adaptive radix trees.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+// An adaptive radix tree (Leis, Kemper and Neumann) is a 256-way trie
+// whose nodes come in four sizes, so that sparse nodes are small:
+//
+// Node4   up to 4 children, with a sorted array of their key bytes
+// Node16  up to 16 children, searched with SSE2 when it is available
+// Node48  a 256 byte index into an array of up to 48 children
+// Node256 an array of 256 children
+//
+// A node grows to the next size when it is full and shrinks when it
+// is about a quarter full. Each node has a compressed path prefix:
+// the number of key bytes that all the keys below it share, of which
+// the first Tmaxprefix are stored in the node. Longer prefixes are
+// checked optimistically during a lookup, because the leaf's key is
+// compared in full at the end; when an insert or delete needs the
+// rest of the prefix, it gets it from a leaf below the node.
+//
+// As in libart, leaves are separately allocated and hold the key
+// pointer, the key length and the value, and a pointer to a leaf is
+// tagged with its bottom bit. Unlike libart, a key that ends at a
+// node is held in the node's end pointer, so one key can be a prefix
+// of another, and keys are byte strings whose length is significant.
+// The values do not need any alignment.
+
+typedef unsigned char byte;
+typedef unsigned int uint;
+
+#define Tmaxprefix 9
+
+enum { N4, N16, N48, N256 };
+
+typedef struct Tleaf {
+	const char *key;
+	size_t len;
+	void *val;
+} Tleaf;
+
+typedef struct Tnode {
+	Tleaf *end;
+	uint32_t prefixlen;
+	uint16_t count;
+	byte type;
+	byte prefix[Tmaxprefix];
+} Tnode;
+
+typedef struct Tnode4 {
+	Tnode n;
+	byte key[4];
+	void *child[4];
+} Tnode4;
+
+typedef struct Tnode16 {
+	Tnode n;
+	byte key[16];
+	void *child[16];
+} Tnode16;
+
+// An index entry is a child's position in the array plus one, or zero
+// if there is no child for that byte.
+
+typedef struct Tnode48 {
+	Tnode n;
+	byte index[256];
+	void *child[48];
+} Tnode48;
+
+typedef struct Tnode256 {
+	Tnode n;
+	void *child[256];
+} Tnode256;
+
+struct Tbl {
+	void *root;
+};
+
+static inline bool
+isleaf(void *p) {
+	return((uintptr_t)p & 1);
+}
+
+static inline Tleaf *
+toleaf(void *p) {
+	return((Tleaf *)((uintptr_t)p - 1));
+}
+
+static inline void *
+leafptr(Tleaf *l) {
+	return((void *)((uintptr_t)l + 1));
+}
+
+static inline bool
+leafmatch(Tleaf *l, const char *key, size_t len) {
+	return(l->len == len && memcmp(l->key, key, len) == 0);
+}
+
+static inline size_t
+nodesize(byte type) {
+	static const size_t size[] = {
+		sizeof(Tnode4), sizeof(Tnode16),
+		sizeof(Tnode48), sizeof(Tnode256),
+	};
+	return(size[type]);
+}
+
+static inline uint
+nodecap(byte type) {
+	static const uint cap[] = { 4, 16, 48, 256 };
+	return(cap[type]);
+}
+
+static inline size_t
+storedprefix(size_t prefixlen) {
+	return(prefixlen < Tmaxprefix ? prefixlen : Tmaxprefix);
+}
+
+// List a node's children in key order. Returns the number of children.
+
+static inline uint
+children(Tnode *n, byte keys[256], void *kids[256]) {
+	uint m = 0;
+	switch(n->type) {
+	case(N4): {
+		Tnode4 *n4 = (Tnode4 *)n;
+		for(; m < n->count; m++)
+			keys[m] = n4->key[m], kids[m] = n4->child[m];
+		return(m);
+	}
+	case(N16): {
+		Tnode16 *n16 = (Tnode16 *)n;
+		for(; m < n->count; m++)
+			keys[m] = n16->key[m], kids[m] = n16->child[m];
+		return(m);
+	}
+	case(N48): {
+		Tnode48 *n48 = (Tnode48 *)n;
+		for(uint c = 0; c < 256; c++)
+			if(n48->index[c] != 0)
+				keys[m] = (byte)c,
+				kids[m++] = n48->child[n48->index[c] - 1];
+		return(m);
+	}
+	default: {
+		Tnode256 *n256 = (Tnode256 *)n;
+		for(uint c = 0; c < 256; c++)
+			if(n256->child[c] != NULL)
+				keys[m] = (byte)c, kids[m++] = n256->child[c];
+		return(m);
+	}
+	}
+}
@@ -11,10 +11,17 @@ sub maxlen {
 
 sub usage {
 	die <<EOF;
-usage: $0 <count> <prog>... -- <input>...
+usage: $0 [-l] [-k keys] [-m misses] <count> <prog>... -- <input>...
+	The options are passed to each prog.
 EOF
 }
 
+my @opt;
+while (@ARGV and $ARGV[0] =~ m{^-[klm]}) {
+	push @opt, shift;
+	push @opt, shift if $opt[-1] =~ m{^-[km]$};
+}
+
 usage if @ARGV < 4 or $ARGV[0] !~ m{^\d+$};
 my $count = shift;
 
@@ -31,6 +38,14 @@ my $waf = ($wf+1) * scalar @file;
 
 my %stats;
 
+# per-operation latency percentiles, summed over runs
+my %lat;
+my @pct = qw(p50 p90 p99 p99.9 max);
+
+# perf counters per operation, summed over runs
+my %perf;
+my @perf;
+
 open my $rnd, '<', '/dev/urandom'
     or die "open /dev/urandom: $!\n";
 
@@ -41,8 +56,8 @@ for (my $N = 1 ;; ++$N) {
 
 	for my $file (@file) {
 		for my $prog (@prog) {
-			print "$prog $seed $count $file\n";
-			for (qx{$prog $seed $count $file}) {
+			print "$prog @opt $seed $count $file\n";
+			for (qx{$prog @opt $seed $count $file}) {
 				if(m{^(\w+)... ([0-9.]+) s$}) {
 					my $test = $1;
 					my $time = $2;
@@ -53,6 +68,21 @@ for (my $N = 1 ;; ++$N) {
 					$stats{$test}{$prog}{$file}{tot} += $time;
 					$stats{$test}{$prog}{$file}{tot2} += $time * $time;
 				}
+				if(m{^- (\w+) latency (.*) ns$}) {
+					my $test = $1;
+					my %p = split ' ', $2;
+					$lat{$test}{$prog}{$file}{$_} += $p{$_}
+					    for keys %p;
+				}
+				if(m{^- (\w+) perf (.*) per op$}) {
+					my $test = $1;
+					my @p = split ' ', $2;
+					while (my ($ctr, $n) = splice @p, 0, 2) {
+						push @perf, $ctr
+						    unless exists $perf{$ctr};
+						$perf{$ctr}{$test}{$prog}{$file} += $n;
+					}
+				}
 			}
 		}
 	}
@@ -78,4 +108,48 @@ for (my $N = 1 ;; ++$N) {
 		print "\n";
 	}
 
+	# mean of each run's latency percentiles, in nanoseconds
+	for my $test (sort keys %lat) {
+		for my $file (@file) {
+			my $wl = maxlen @prog, "$test $file";
+			printf "%-*s |", $wl, "$test $file";
+			printf " %7s", $_ for @pct;
+			print "\n";
+			for my $prog (@prog) {
+				printf "%-*s |", $wl, $prog;
+				printf " %7.0f",
+				    ($lat{$test}{$prog}{$file}{$_} // 0) / $N
+				    for @pct;
+				print "\n";
+			}
+		}
+	}
+
+	# mean perf counts per operation, laid out like the times
+	# so that bench-reformat.pl can turn them into tables
+	for my $ctr (@perf) {
+		my @test = sort keys %{$perf{$ctr}};
+		my $wc = maxlen @prog, $ctr;
+		printf "%-*s ", $wc, $ctr;
+		printf "| %-*s", $waf, $_ for @test;
+		print "\n";
+		printf "%-*s", $wc, "";
+		for (@test) {
+			printf " |";
+			printf " %*s", $wf, $_ for @file;
+		}
+		print "\n";
+		for my $prog (@prog) {
+			printf "%-*s", $wc, $prog;
+			for my $test (@test) {
+				printf " |";
+				for my $file (@file) {
+					my $n = $perf{$ctr}{$test}{$prog}{$file};
+					printf " %*.3f", $wf, ($n // 0) / $N;
+				}
+			}
+			print "\n";
+		}
+	}
+
 }
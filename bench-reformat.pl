@@ -3,7 +3,11 @@
 use warnings;
 use strict;
 
-my @test = <> =~ m{(?:[|]\s+(\w+)\s+)}g;
+# A perf counter table from bench-more.pl has the counter's name
+# before the list of tests.
+my $head = <>;
+my ($caption) = $head =~ m{^\s*([^|\s]+)};
+my @test = $head =~ m{(?:[|]\s+(\w+)\s+)}g;
 #printf "tests: %s\n", join " ", @test;
 
 my @file = split m{\s+[|]\s+}, scalar <>;
@@ -38,9 +42,10 @@ while (<>) {
 my %min;
 for my $test (@test) {
 	for my $file (@file) {
-		my $min = 99;
+		my $min;
 		for my $prog (@prog) {
-			if ($min > $stats{$test}{$file}{$prog}) {
+			if (not defined $min or
+			    $min > $stats{$test}{$file}{$prog}) {
 				$min = $stats{$test}{$file}{$prog};
 				$min{$test}{$file} = $prog;
 			}
@@ -49,6 +54,7 @@ for my $test (@test) {
 }
 
 print "<table>\n";
+print "<caption>$caption</caption>\n" if defined $caption;
 print "<tr><th></th>";
 print "<th>$_</th>" for @file;
 print "<th></th></tr>\n";
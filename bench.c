@@ -7,6 +7,8 @@
 #include <assert.h>
 #include <errno.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -14,9 +16,17 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 
+#include <time.h>
+
 #include <fcntl.h>
 #include <unistd.h>
 
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
 #include "Tbl.h"
 
 static const char *progname;
@@ -30,23 +40,210 @@ die(const char *cause) {
 static void
 usage(void) {
 	fprintf(stderr,
-"usage: %s <seed> <count> <input>\n"
+"usage: %s [-l] [-k keys] [-m misses] <seed> <count> <input>\n"
 "	The seed must be at least 12 characters.\n"
+"	-k uniform	lookups choose keys uniformly (the default)\n"
+"	-k seq		lookups go through the keys in input order\n"
+"	-k zipf:S	the nth most popular key has weight 1/n^S\n"
+"	-k hot:P:Q	P%% of the keys get Q%% of the lookups\n"
+"	-m M		M%% of searches are for absent keys\n"
+"	-l		sample per-operation latency, which adds its\n"
+"			clock reads to the times and perf counts\n"
 		, progname);
 	exit(1);
 }
 
+// With -l, per-operation latency is sampled for one in every Lsample
+// operations and counted in a log-linear histogram, like HdrHistogram:
+// a time is bucketed by its top bit and the Lsubbits bits below it, so
+// a bucket's times are within 1/2^Lsubbits of each other. It is off by
+// default so that the phase times and perf counts are only the table
+// operations, not the clock reads.
+
+#define Lsample 16
+#define Lsubbits 4
+#define Lbuckets (64 << Lsubbits)
+
+static bool lsample;
+
+static struct {
+	const char *phase;
+	uint64_t count[Lbuckets];
+	uint64_t samples, max;
+} lat;
+
+static inline uint64_t
+nsnow(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return((uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec);
+}
+
+static inline unsigned
+lbucket(uint64_t ns) {
+	if(ns < (1 << Lsubbits))
+		return((unsigned)ns);
+	unsigned e = 63 - (unsigned)__builtin_clzll(ns);
+	unsigned m = (unsigned)(ns >> (e - Lsubbits));
+	return(((e - Lsubbits + 1) << Lsubbits) + m - (1 << Lsubbits));
+}
+
+// The smallest time in a bucket.
+static inline uint64_t
+lvalue(unsigned b) {
+	if(b < (1 << Lsubbits))
+		return(b);
+	unsigned e = (b >> Lsubbits) + Lsubbits - 1;
+	uint64_t m = (b & ((1 << Lsubbits) - 1)) + (1 << Lsubbits);
+	return(m << (e - Lsubbits));
+}
+
+// Returns the start time if operation i is sampled, or zero.
+static inline uint64_t
+sample(size_t i) {
+	return(lsample && i % Lsample == 0 ? nsnow() : 0);
+}
+
+static inline void
+sampled(uint64_t t0) {
+	if(t0 == 0) return;
+	uint64_t ns = nsnow() - t0;
+	lat.count[lbucket(ns)] += 1;
+	lat.samples += 1;
+	if(lat.max < ns)
+		lat.max = ns;
+}
+
+static uint64_t
+percentile(double p) {
+	uint64_t want = (uint64_t)(p / 100.0 * (double)lat.samples + 0.5);
+	uint64_t n = 0;
+	if(want == 0) want = 1;
+	for(unsigned b = 0; b < Lbuckets; b++)
+		if((n += lat.count[b]) >= want)
+			return(lvalue(b));
+	return(lat.max);
+}
+
+static void
+latency(void) {
+	if(lat.samples == 0) return;
+	printf("- %s latency", lat.phase);
+	static const double p[] = { 50, 90, 99, 99.9 };
+	for(unsigned i = 0; i < sizeof(p) / sizeof(*p); i++)
+		printf(" p%g %llu", p[i], (unsigned long long)percentile(p[i]));
+	printf(" max %llu ns\n", (unsigned long long)lat.max);
+}
+
+// Hardware performance counters for each phase, on Linux. A counter
+// that the kernel or the CPU does not support (or that we are not
+// allowed to use) is left out. The counters are opened separately
+// rather than as a group, so if there are more than the CPU can count
+// at once the kernel multiplexes them, and we scale each count by the
+// fraction of the phase it was running.
+
+#ifdef __linux__
+
+static struct {
+	const char *name;
+	uint32_t type;
+	uint64_t config;
+	int fd;
+} pc[] = {
+	{ "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1 },
+	{ "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, -1 },
+	{ "branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, -1 },
+	{ "L1d-misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+	  PERF_COUNT_HW_CACHE_OP_READ << 8 |
+	  PERF_COUNT_HW_CACHE_RESULT_MISS << 16, -1 },
+	{ "LLC-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, -1 },
+	{ "dTLB-misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+	  PERF_COUNT_HW_CACHE_OP_READ << 8 |
+	  PERF_COUNT_HW_CACHE_RESULT_MISS << 16, -1 },
+	{ "page-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, -1 },
+};
+
+#define PCOUNT (sizeof(pc) / sizeof(*pc))
+
+static void
+pcopen(void) {
+	unsigned n = 0;
+	for(unsigned i = 0; i < PCOUNT; i++) {
+		struct perf_event_attr pe;
+		memset(&pe, 0, sizeof(pe));
+		pe.size = sizeof(pe);
+		pe.type = pc[i].type;
+		pe.config = pc[i].config;
+		pe.disabled = 1;
+		pe.exclude_kernel = 1;
+		pe.exclude_hv = 1;
+		pe.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+			PERF_FORMAT_TOTAL_TIME_RUNNING;
+		pc[i].fd = (int)syscall(SYS_perf_event_open, &pe, 0, -1, -1, 0);
+		if(pc[i].fd >= 0) n++;
+	}
+	if(n == 0)
+		printf("- no perf counters: %s\n", strerror(errno));
+}
+
+static void
+pcstart(void) {
+	for(unsigned i = 0; i < PCOUNT; i++) {
+		if(pc[i].fd < 0) continue;
+		ioctl(pc[i].fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(pc[i].fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+}
+
+static void
+pcstop(void) {
+	for(unsigned i = 0; i < PCOUNT; i++)
+		if(pc[i].fd >= 0)
+			ioctl(pc[i].fd, PERF_EVENT_IOC_DISABLE, 0);
+}
+
+static void
+pcdone(const char *phase, size_t ops) {
+	bool any = false;
+	for(unsigned i = 0; i < PCOUNT; i++) {
+		if(pc[i].fd < 0) continue;
+		uint64_t v[3];
+		if(read(pc[i].fd, v, sizeof(v)) != sizeof(v) || v[2] == 0)
+			continue;
+		double count = (double)v[0] * (double)v[1] / (double)v[2];
+		if(!any) printf("- %s perf", phase);
+		printf(" %s %.3f", pc[i].name, count / (double)ops);
+		any = true;
+	}
+	if(any) printf(" per op\n");
+}
+
+#else
+
+static void pcopen(void) { }
+static void pcstart(void) { }
+static void pcstop(void) { }
+static void pcdone(const char *phase, size_t ops) { (void)phase; (void)ops; }
+
+#endif
+
 static struct timeval tu;
 
 static void
 start(const char *s) {
 	printf("%s... ", s);
+	memset(&lat, 0, sizeof(lat));
+	lat.phase = s;
+	pcstart();
 	gettimeofday(&tu, NULL);
 }
 
+// The number of operations is used to normalize the perf counters.
+
 static void
-done(void) {
+done(size_t ops) {
 	struct timeval tv;
+	pcstop();
 	gettimeofday(&tv, NULL);
 	tv.tv_sec -= tu.tv_sec;
 	tv.tv_usec -= tu.tv_usec;
@@ -55,6 +252,8 @@ done(void) {
 		tv.tv_usec += 1000000;
 	}
 	printf("%ld.%06d s\n", tv.tv_sec, tv.tv_usec);
+	latency();
+	pcdone(lat.phase, ops);
 }
 
 static int
@@ -67,12 +266,139 @@ ssrandom(char *s) {
 	return(0);
 }
 
+// The workload for the search, miss, and mutate phases. Keys are
+// chosen by rank, and ranks are mapped to lines by a random
+// permutation so that popular keys are scattered through the table
+// rather than clustered in input order.
+
+static const char *keyspec = "uniform";
+static enum { uniform, seq, zipf, hot } dist = uniform;
+static double zipf_s;
+static unsigned hot_p, hot_q;
+static unsigned misspct;
+
+static size_t *rank;
+static double *zcdf;
+
+static void
+keys(const char *spec) {
+	char tail;
+	if(strcmp(spec, "uniform") == 0)
+		dist = uniform;
+	else if(strcmp(spec, "seq") == 0)
+		dist = seq;
+	else if(sscanf(spec, "zipf:%lf%c", &zipf_s, &tail) == 1 &&
+		zipf_s > 0)
+		dist = zipf;
+	else if(sscanf(spec, "hot:%u:%u%c", &hot_p, &hot_q, &tail) == 2 &&
+		hot_p > 0 && hot_p < 100 && hot_q <= 100)
+		dist = hot;
+	else
+		usage();
+	keyspec = spec;
+}
+
+static void
+workprep(size_t lines) {
+	if(dist == uniform || dist == seq)
+		return;
+	rank = malloc(lines * sizeof(*rank));
+	if(rank == NULL) die("malloc");
+	for(size_t i = 0; i < lines; i++)
+		rank[i] = i;
+	for(size_t i = lines - 1; i > 0; i--) {
+		size_t j = (size_t)random() % (i + 1);
+		size_t r = rank[i]; rank[i] = rank[j]; rank[j] = r;
+	}
+	if(dist != zipf)
+		return;
+	zcdf = malloc(lines * sizeof(*zcdf));
+	if(zcdf == NULL) die("malloc");
+	double sum = 0;
+	for(size_t i = 0; i < lines; i++)
+		zcdf[i] = sum += pow((double)(i + 1), -zipf_s);
+}
+
+// A uniform random number in [0,1) with more bits than random().
+static double
+urandom(void) {
+	uint64_t r = (uint64_t)random() << 31 | (uint64_t)random();
+	return((double)r / (double)(1ULL << 62));
+}
+
+static size_t
+pick(size_t i, size_t lines) {
+	switch(dist) {
+	case(uniform):
+		return((size_t)random() % lines);
+	case(seq):
+		return(i % lines);
+	case(zipf): {
+		double u = urandom() * zcdf[lines - 1];
+		size_t lo = 0, hi = lines - 1;
+		while(lo < hi) {
+			size_t mid = lo + (hi - lo) / 2;
+			if(zcdf[mid] < u) lo = mid + 1;
+			else hi = mid;
+		}
+		return(rank[lo]);
+	}
+	default: {
+		size_t h = lines * hot_p / 100;
+		if(h == 0) h = 1;
+		if(h == lines || (unsigned)random() % 100 < hot_q)
+			return(rank[(size_t)random() % h]);
+		return(rank[h + (size_t)random() % (lines - h)]);
+	}
+	}
+}
+
+// Fill op[] with N keys from the workload, taking misspct percent
+// of them from miss[] rather than line[]. Returns the number of
+// keys that are present.
+
+static size_t
+workload(const char **op, size_t N, char **line, char **miss,
+	 size_t lines, unsigned pct) {
+	size_t hits = 0;
+	for(size_t i = 0; i < N; i++) {
+		size_t l = pick(i, lines);
+		if(pct > 0 && (unsigned)random() % 100 < pct) {
+			op[i] = miss[l];
+		} else {
+			op[i] = line[l];
+			hits++;
+		}
+	}
+	return(hits);
+}
+
 int
 main(int argc, char *argv[]) {
 	progname = argv[0];
-	if(argc != 4 || argv[1][0] == '-') usage();
+	int opt;
+	while((opt = getopt(argc, argv, "k:lm:")) != -1) {
+		switch(opt) {
+		case('k'):
+			keys(optarg);
+			continue;
+		case('l'):
+			lsample = true;
+			continue;
+		case('m'):
+			misspct = (unsigned)atoi(optarg);
+			if(misspct > 100) usage();
+			continue;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind - 1;
+	if(argc != 3) usage();
 	if(ssrandom(argv[1]) < 0) usage();
 	int N = atoi(argv[2]);
+	if(N < 0) usage();
 
 	int fd = open(argv[3], O_RDONLY);
 	if(fd < 0) die("open");
@@ -103,35 +429,88 @@ main(int argc, char *argv[]) {
 		}
 	}
 	printf("- got %zu lines\n", lines);
+	printf("- keys %s, %u%% misses\n", keyspec, misspct);
+	pcopen();
+	workprep(lines);
+	const char **op = calloc((size_t)N, sizeof(*op));
+	if(op == NULL && N > 0) die("malloc");
 
 	start("load");
 	Tbl *t = NULL;
-	for(l = 0; l < lines; l++)
+	for(l = 0; l < lines; l++) {
+		uint64_t t0 = sample(l);
 		t = Tset(t, line[l], main);
-	done();
+		sampled(t0);
+	}
+	done(lines);
+
+	// Absent keys that share a prefix with a present key, so a
+	// lookup usually has to get as far as a leaf.
+	char **miss = calloc(lines, sizeof(*miss));
+	char *mbuf = malloc(flen + lines * 2);
+	if(miss == NULL || mbuf == NULL) die("malloc");
+	char *m = mbuf;
+	for(l = 0; l < lines; l++) {
+		size_t len = strlen(line[l]);
+		miss[l] = memcpy(m, line[l], len);
+		m[len] = '\x7f';
+		m[len+1] = '\0';
+		m += len + 2;
+		if(Tget(t, miss[l]) != NULL)
+			miss[l] = "\x7f\x7f";
+	}
 
+	size_t hits = workload(op, (size_t)N, line, miss, lines, misspct);
 	start("search");
 	l = 0;
-	for(int i = 0; i < N; i++)
-		if(Tget(t, line[random() % lines]) != NULL)
+	for(int i = 0; i < N; i++) {
+		uint64_t t0 = sample((size_t)i);
+		if(Tget(t, op[i]) != NULL)
+			++l;
+		sampled(t0);
+	}
+	assert(l == hits);
+	done((size_t)N);
+
+	workload(op, (size_t)N, line, miss, lines, 100);
+	start("miss");
+	l = 0;
+	for(int i = 0; i < N; i++) {
+		uint64_t t0 = sample((size_t)i);
+		if(Tget(t, op[i]) != NULL)
 			++l;
-	assert(l == N);
-	done();
+		sampled(t0);
+	}
+	assert(l == 0);
+	done((size_t)N);
 
+	workload(op, (size_t)N, line, miss, lines, 0);
 	start("mutate");
-	for(int i = 0; i < N; i++)
-		t = Tset(t, line[random() % lines],
-			 random() % 2 ? main : NULL);
-	done();
+	for(int i = 0; i < N; i++) {
+		void *val = random() % 2 ? main : NULL;
+		uint64_t t0 = sample((size_t)i);
+		t = Tset(t, op[i], val);
+		sampled(t0);
+	}
+	done((size_t)N);
 
 	// ensure all keys present
 	for(l = 0; l < lines; l++)
 		t = Tset(t, line[l], main);
 	start("free");
-	for(l = 0; l < lines; l++)
+	for(l = 0; l < lines; l++) {
+		uint64_t t0 = sample(l);
 		t = Tset(t, line[l], NULL);
+		sampled(t0);
+	}
 	assert(t == NULL);
-	done();
+	done(lines);
+
+	free(op);
+	free(miss);
+	free(mbuf);
+	free(rank);
+	free(zcdf);
 
 	return(0);
 }
@@ -23,7 +23,7 @@ Tgetkv(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
 		__builtin_prefetch(t->branch.twigs);
 		t = twig(t, twigoff(t, key, len));
 	}
-	if(strcmp(key, t->leaf.key) != 0)
+	if(!leafmatch(t, key, len))
 		return(false);
 	*pkey = t->leaf.key;
 	*pval = t->leaf.val;
@@ -43,12 +43,12 @@ next_rec(Trie *t, const char **pkey, size_t *plen, void **pval) {
 	// We have found the next leaf.
 	if(*pkey == NULL) {
 		*pkey = t->leaf.key;
-		*plen = strlen(*pkey);
+		*plen = leaflen(t);
 		*pval = t->leaf.val;
 		return(true);
 	}
 	// We have found this leaf, so start looking for the next one.
-	if(strcmp(*pkey, t->leaf.key) == 0) {
+	if(leafmatch(t, *pkey, *plen)) {
 		*pkey = NULL;
 		*plen = 0;
 		return(false);
@@ -67,6 +67,23 @@ Tnextl(Tbl *tbl, const char **pkey, size_t *plen, void **pval) {
 	return(next_rec(&tbl->root, pkey, plen, pval));
 }
 
+static void
+free_rec(Trie *t) {
+	if(!isbranch(t))
+		return;
+	free_rec(twig(t, 0));
+	free_rec(twig(t, 1));
+	free(t->branch.twigs);
+}
+
+void
+Tfree(Tbl *tbl) {
+	if(tbl == NULL)
+		return;
+	free_rec(&tbl->root);
+	free(tbl);
+}
+
 Tbl *
 Tdelkv(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
 	if(tbl == NULL)
@@ -78,7 +95,7 @@ Tdelkv(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
 		b = twigoff(t, key, len);
 		p = t, t = twig(t, b);
 	}
-	if(strcmp(key, t->leaf.key) != 0)
+	if(!leafmatch(t, key, len))
 		return(tbl);
 	*pkey = t->leaf.key;
 	*pval = t->leaf.val;
@@ -106,8 +123,7 @@ Tsetl(Tbl *tbl, const char *key, size_t len, void *val) {
 	if(tbl == NULL) {
 		tbl = malloc(sizeof(*tbl));
 		if(tbl == NULL) return(NULL);
-		tbl->root.leaf.key = key;
-		tbl->root.leaf.val = val;
+		leafset(&tbl->root, key, len, val);
 		return(tbl);
 	}
 	Trie *t = &tbl->root;
@@ -119,6 +135,28 @@ Tsetl(Tbl *tbl, const char *key, size_t len, void *val) {
 		t = twig(t, twigoff(t, key, len));
 	// Do the keys differ, and if so, where?
 	size_t i;
+#ifdef HAVE_BINARY_KEYS
+	size_t tlen = t->leaf.len;
+	for(i = 0; i < len && i < tlen; i++) {
+		if(key[i] != t->leaf.key[i])
+			goto newkey;
+	}
+	if(len == tlen) {
+		t->leaf.val = val;
+		return(tbl);
+	}
+	// One key is a prefix of the other, so they differ in the
+	// presence bit of the next byte.
+	uint b = len > tlen;
+	i = 9 * i;
+	goto findbranch;
+newkey:; // We have the byte index; what about the bit?
+	uint k1 = (byte)key[i], k2 = (byte)t->leaf.key[i];
+	b = (uint)__builtin_clz((k1 ^ k2) << 24 | 0x800000);
+	i = 9 * i + 1 + b;
+	b = k1 >> (7 - b) & 1;
+findbranch:;
+#else
 	for(i = 0; i <= len; i++) {
 		if(key[i] != t->leaf.key[i])
 			goto newkey;
@@ -130,6 +168,7 @@ newkey:; // We have the byte index; what about the bit?
 	uint b = (uint)__builtin_clz((k1 ^ k2) << 24 | 0x800000);
 	i = 8 * i + b;
 	b = k1 >> (7 - b) & 1;
+#endif
 	// Find where to insert a branch or grow an existing branch.
 	t = &tbl->root;
 	while(isbranch(t)) {
@@ -141,7 +180,8 @@ newkey:; // We have the byte index; what about the bit?
 newbranch:;
 	Trie *twigs = malloc(sizeof(Trie) * 2);
 	if(twigs == NULL) return(NULL);
-	Trie t1 = { .leaf = { .key = key, .val = val } };
+	Trie t1;
+	leafset(&t1, key, len, val);
 	Trie t2 = *t; // Save before overwriting.
 	t->branch.twigs = twigs;
 	t->branch.isbranch = 1;
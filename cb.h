@@ -64,9 +64,18 @@
 typedef unsigned char byte;
 typedef unsigned int uint;
 
+// With HAVE_BINARY_KEYS the leaf has a third word for the key's
+// length, so every node is three words. Each byte of the key is
+// treated as nine bits: the first is set if the byte is present and
+// clear after the end of the key, so that a key sorts before its
+// extensions, and the other eight are the byte's bits as usual.
+
 typedef struct Tleaf {
 	const char *key;
 	void *val;
+#ifdef HAVE_BINARY_KEYS
+	size_t len;
+#endif
 } Tleaf;
 
 // XXX this currently assumes a 64 bit little endian machine
@@ -96,11 +105,57 @@ isbranch(Trie *t) {
 static inline uint
 twigoff(Trie *t, const char *key, size_t len) {
 	uint64_t i = t->branch.index;
+#ifdef HAVE_BINARY_KEYS
+	if(i/9 >= len) return(0);
+	if(i%9 == 0) return(1);
+	return(key[i/9] >> (8 - i%9) & 1);
+#else
 	if(i/8 >= len) return(0);
 	return(key[i/8] >> (7 - i%8) & 1);
+#endif
 }
 
 static inline Trie *
 twig(Trie *t, uint i) {
 	return(&t->branch.twigs[i]);
 }
+
+// Leaf accessors that depend on whether keys are '\0' terminated.
+
+static inline void
+leafset(Trie *t, const char *key, size_t len, void *val) {
+	t->leaf.key = key;
+	t->leaf.val = val;
+#ifdef HAVE_BINARY_KEYS
+	t->leaf.len = len;
+#else
+	(void)len;
+#endif
+}
+
+#ifdef HAVE_BINARY_KEYS
+
+static inline size_t
+leaflen(Trie *t) {
+	return(t->leaf.len);
+}
+
+static inline bool
+leafmatch(Trie *t, const char *key, size_t len) {
+	return(len == t->leaf.len && memcmp(key, t->leaf.key, len) == 0);
+}
+
+#else
+
+static inline size_t
+leaflen(Trie *t) {
+	return(strlen(t->leaf.key));
+}
+
+static inline bool
+leafmatch(Trie *t, const char *key, size_t len) {
+	(void)len;
+	return(strcmp(key, t->leaf.key) == 0);
+}
+
+#endif
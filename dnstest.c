@@ -0,0 +1,169 @@
+// dnstest.c: test DNS name lookups.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#define _WITH_GETLINE
+
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Tbl.h"
+#include "Tdns.h"
+
+static const char *progname;
+
+static void
+die(const char *cause) {
+	fprintf(stderr, "%s: %s: %s\n", progname, cause, strerror(errno));
+	exit(1);
+}
+
+static void
+fail(const char *what, const char *key, size_t len) {
+	char name[Tdnsnamemax];
+	Tdnsname(name, key, len);
+	fprintf(stderr, "%s: %s mismatch for %s\n", progname, what, name);
+	exit(1);
+}
+
+static void
+usage(void) {
+	fprintf(stderr,
+"usage: %s <count> <input>\n"
+"	Load up to <count> domain names from the input and check\n"
+"	Tencloser() and Tprevl() against the obvious slow methods.\n"
+	    , progname);
+	exit(1);
+}
+
+static int
+compare(const void *a, const void *b) {
+	return(strcmp(*(char *const *)a, *(char *const *)b));
+}
+
+// The closest encloser, by looking up each ancestor in turn.
+static const char *
+slow_encloser(Tbl *t, const char *key, size_t len) {
+	char buf[Tdnskeymax];
+	memcpy(buf, key, len + 1);
+	for(;;) {
+		const char *rkey = NULL;
+		void *rval = NULL;
+		if(Tgetkv(t, buf, len, &rkey, &rval))
+			return(rkey);
+		if(len == 0)
+			return(NULL);
+		do buf[--len] = '\0';
+		while(len > 0 && buf[len-1] != Tdnssep);
+	}
+}
+
+// The predecessor, by binary search of the sorted keys.
+static const char *
+slow_prev(char **keys, size_t n, const char *key) {
+	size_t lo = 0, hi = n;
+	while(lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if(strcmp(keys[mid], key) <= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return(lo == 0 ? NULL : keys[lo - 1]);
+}
+
+static void
+check(Tbl *t, char **keys, size_t n, const char *name) {
+	char key[Tdnskeymax];
+	size_t len;
+	if(!Tdnskey(key, &len, name))
+		return;
+	const char *rkey = NULL;
+	void *rval = NULL;
+	if(!Tencloser(t, key, len, &rkey, &rval))
+		rkey = NULL;
+	if(rkey != slow_encloser(t, key, len))
+		fail("Tencloser", key, len);
+	if(!Tprevl(t, key, len, &rkey, &rval))
+		rkey = NULL;
+	if(rkey != slow_prev(keys, n, key))
+		fail("Tprevl", key, len);
+}
+
+int
+main(int argc, char *argv[]) {
+	progname = argv[0];
+	if(argc != 3 || argv[1][0] == '-')
+		usage();
+	size_t max = (size_t)atol(argv[1]);
+	if(freopen(argv[2], "r", stdin) == NULL)
+		die("open");
+	char **keys = calloc(max, sizeof(*keys));
+	char **names = calloc(max, sizeof(*names));
+	if(keys == NULL || names == NULL)
+		die("calloc");
+	Tbl *t = NULL;
+	size_t n = 0;
+	char *line = NULL;
+	size_t size = 0;
+	while(n < max && getline(&line, &size, stdin) > 0) {
+		line[strcspn(line, "\n")] = '\0';
+		char key[Tdnskeymax];
+		size_t len;
+		if(!Tdnskey(key, &len, line))
+			continue;
+		if(Tgetl(t, key, len) != NULL)
+			continue;
+		keys[n] = strdup(key);
+		names[n] = strdup(line);
+		if(keys[n] == NULL || names[n] == NULL)
+			die("strdup");
+		t = Tsetl(t, keys[n], len, keys[n]);
+		if(t == NULL)
+			die("Tbl");
+		n++;
+	}
+	free(line);
+	if(ferror(stdin))
+		die("read");
+	// Check that the iteration order matches strcmp()
+	qsort(keys, n, sizeof(*keys), compare);
+	const char *key = NULL;
+	void *val = NULL;
+	for(size_t i = 0; Tnext(t, &key, &val); i++)
+		if(i >= n || key != keys[i])
+			fail("Tnext", key, strlen(key));
+	// Each name, some of its descendants, and some unrelated names.
+	char query[Tdnsnamemax * 2];
+	for(size_t i = 0; i < n; i++) {
+		check(t, keys, n, names[i]);
+		snprintf(query, sizeof(query), "*.%s", names[i]);
+		check(t, keys, n, query);
+		snprintf(query, sizeof(query), "zz.%s", names[i]);
+		check(t, keys, n, query);
+		snprintf(query, sizeof(query), "a.b.%s", names[i]);
+		check(t, keys, n, query);
+		snprintf(query, sizeof(query), "%sx", names[i]);
+		check(t, keys, n, query);
+		snprintf(query, sizeof(query), "%s-", names[i]);
+		check(t, keys, n, query);
+	}
+	check(t, keys, n, ".");
+	check(t, keys, n, "!");
+	check(t, keys, n, "~");
+	fprintf(stderr, "DNS %zu names ok\n", n);
+	Tfree(t);
+	for(size_t i = 0; i < n; i++) {
+		free(keys[i]);
+		free(names[i]);
+	}
+	free(keys);
+	free(names);
+	return(0);
+}
@@ -0,0 +1,64 @@
+// eb-debug.c: embedded crit-bit trie debug support
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Ebl.h"
+#include "eb.h"
+
+static void
+dump_rec(void *t, int d) {
+	Enode *n = tonode(t);
+	if(isleaf(t)) {
+		printf("Edump%*s leaf %p %s\n", d, "", n, n->key);
+		return;
+	}
+	printf("Edump%*s branch %p %zu %zu %u\n", d, "", n,
+	       n->index, n->index / 8, (uint)(n->index % 8));
+	for(uint i = 0; i <= 1; i++) {
+		printf("Edump%*s twig %u\n", d, "", i);
+		dump_rec(n->twig[i], d + 1);
+	}
+}
+
+void
+Edump(Etree *tree) {
+	printf("Edump root %p\n", tree->root);
+	if(tree->root != NULL)
+		dump_rec(tree->root, 0);
+}
+
+static void
+size_rec(void *t, size_t index, size_t d,
+    size_t *rdepth, size_t *rbranches, size_t *rleaves) {
+	if(isleaf(t)) {
+		*rleaves += 1;
+		*rdepth += d;
+		return;
+	}
+	// Check the invariant that a node's branch is an ancestor of
+	// its leaf, and that the indexes increase down the tree.
+	Enode *b = tonode(t);
+	assert(d == 0 || b->index > index);
+	assert(Eget(&(Etree){ .root = t }, b->key, strlen(b->key)) == b);
+	*rbranches += 1;
+	size_rec(b->twig[0], b->index, d + 1, rdepth, rbranches, rleaves);
+	size_rec(b->twig[1], b->index, d + 1, rdepth, rbranches, rleaves);
+}
+
+void
+Esize(Etree *tree,
+    size_t *rsize, size_t *rdepth, size_t *rbranches, size_t *rleaves) {
+	*rsize = *rdepth = *rbranches = *rleaves = 0;
+	if(tree->root != NULL)
+		size_rec(tree->root, 0, 0, rdepth, rbranches, rleaves);
+	*rsize = *rleaves * sizeof(Enode);
+}
@@ -0,0 +1,146 @@
+// eb.c: embedded crit-bit tries.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Ebl.h"
+#include "eb.h"
+
+Enode *
+Eget(Etree *tree, const char *key, size_t len) {
+	void *t = tree->root;
+	if(t == NULL)
+		return(NULL);
+	while(!isleaf(t)) {
+		Enode *b = tonode(t);
+		t = b->twig[twigoff(b, key, len)];
+	}
+	Enode *n = tonode(t);
+	if(strcmp(key, n->key) != 0)
+		return(NULL);
+	return(n);
+}
+
+static Enode *
+next_rec(void *t, const char **pkey, size_t len) {
+	if(isleaf(t)) {
+		// We have found the next leaf.
+		Enode *n = tonode(t);
+		if(*pkey == NULL)
+			return(n);
+		// We have found this leaf, so start looking for the
+		// next one.
+		if(strcmp(*pkey, n->key) == 0)
+			*pkey = NULL;
+		return(NULL);
+	}
+	// Recurse to find either this leaf (*pkey != NULL)
+	// or the next one (*pkey == NULL).
+	Enode *b = tonode(t);
+	uint i = *pkey == NULL ? 0 : twigoff(b, *pkey, len);
+	for(; i <= 1; i++) {
+		Enode *n = next_rec(b->twig[i], pkey, len);
+		if(n != NULL)
+			return(n);
+	}
+	return(NULL);
+}
+
+Enode *
+Enext(Etree *tree, Enode *node) {
+	if(tree->root == NULL)
+		return(NULL);
+	const char *key = node == NULL ? NULL : node->key;
+	size_t len = node == NULL ? 0 : strlen(key);
+	return(next_rec(tree->root, &key, len));
+}
+
+Enode *
+Edel(Etree *tree, const char *key, size_t len) {
+	void **pt = &tree->root, **pp = NULL;
+	if(*pt == NULL)
+		return(NULL);
+	uint b = 0;
+	while(!isleaf(*pt)) {
+		Enode *br = tonode(*pt);
+		b = twigoff(br, key, len);
+		pp = pt, pt = &br->twig[b];
+	}
+	Enode *leaf = tonode(*pt);
+	if(strcmp(key, leaf->key) != 0)
+		return(NULL);
+	if(pp == NULL) {
+		tree->root = NULL;
+		return(leaf);
+	}
+	// Unlink the leaf's parent branch, replacing it with the leaf's
+	// sibling. The parent's branch is now unused.
+	Enode *parent = tonode(*pp);
+	*pp = parent->twig[!b];
+	if(parent == leaf)
+		return(leaf);
+	// If the doomed leaf's own branch is in use, it is an ancestor
+	// of the leaf, so search for it again and move it into the
+	// parent's node.
+	for(pt = &tree->root; !isleaf(*pt); ) {
+		Enode *br = tonode(*pt);
+		if(br == leaf) {
+			parent->twig[0] = leaf->twig[0];
+			parent->twig[1] = leaf->twig[1];
+			parent->index = leaf->index;
+			*pt = branchtwig(parent);
+			break;
+		}
+		pt = &br->twig[twigoff(br, key, len)];
+	}
+	return(leaf);
+}
+
+Enode *
+Eadd(Etree *tree, Enode *node) {
+	const char *key = node->key;
+	size_t len = strlen(key);
+	// First leaf in an empty tree?
+	if(tree->root == NULL) {
+		tree->root = leaftwig(node);
+		return(node);
+	}
+	// Find the most similar leaf, as in cb.c.
+	void *t = tree->root;
+	while(!isleaf(t)) {
+		Enode *b = tonode(t);
+		t = b->twig[twigoff(b, key, len)];
+	}
+	// Do the keys differ, and if so, where?
+	const char *tkey = tonode(t)->key;
+	size_t i;
+	for(i = 0; i <= len; i++) {
+		if(key[i] != tkey[i])
+			goto newkey;
+	}
+	return(tonode(t));
+newkey:; // We have the byte index; what about the bit?
+	uint k1 = (byte)key[i], k2 = (byte)tkey[i];
+	uint b = (uint)__builtin_clz((k1 ^ k2) << 24 | 0x800000);
+	i = 8 * i + b;
+	b = k1 >> (7 - b) & 1;
+	// Find where to insert the new node's branch.
+	void **pt = &tree->root;
+	while(!isleaf(*pt)) {
+		Enode *br = tonode(*pt);
+		if(i < br->index)
+			break;
+		pt = &br->twig[twigoff(br, key, len)];
+	}
+	node->index = i;
+	node->twig[b] = leaftwig(node);
+	node->twig[!b] = *pt;
+	*pt = branchtwig(node);
+	return(node);
+}
@@ -0,0 +1,48 @@
+// eb.h: embedded crit-bit trie internals.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+// See cb.h for crit-bit tries and Ebl.h for the embedded API.
+//
+// Every twig and the root is a pointer to an Enode, tagged in its
+// least significant bit: set if it refers to the node as a leaf, or
+// clear if it refers to the branch embedded in the node. The invariant
+// that makes parent pointers unnecessary is that a node's branch, if
+// it is in use, is an ancestor of the node's leaf, so a search for a
+// key passes through the key's own branch before reaching its leaf.
+//
+// There is always one more leaf than branches, so one node's branch
+// is unused. Initially it is the first node added, but it moves around
+// as nodes are deleted.
+
+typedef unsigned char byte;
+typedef unsigned int uint;
+
+static inline bool
+isleaf(void *t) {
+	return((uintptr_t)t & 1);
+}
+
+static inline Enode *
+tonode(void *t) {
+	return((Enode *)((uintptr_t)t & ~(uintptr_t)1));
+}
+
+static inline void *
+leaftwig(Enode *n) {
+	return((void *)((uintptr_t)n | 1));
+}
+
+static inline void *
+branchtwig(Enode *n) {
+	return(n);
+}
+
+static inline uint
+twigoff(Enode *b, const char *key, size_t len) {
+	size_t i = b->index;
+	if(i/8 >= len) return(0);
+	return(key[i/8] >> (7 - i%8) & 1);
+}
@@ -7,14 +7,26 @@
 typedef unsigned char byte;
 typedef unsigned int uint;
 
+// With HAVE_BINARY_KEYS the bitmap has 33 bits: bit 0 is for the
+// end of the key, which is distinct from a '\0' byte, and the 5-bit
+// chunks are offset by one. The leaf has a third word for the key's
+// length, which leaves room for a wider bitmap in the branch. See the
+// comments in qp.h.
+
+#ifdef HAVE_BINARY_KEYS
+typedef uint64_t Tbitmap;
+#define Tbitmapbits 33
+#else
 typedef uint32_t Tbitmap;
+#define Tbitmapbits 32
+#endif
 
 const char *dump_bitmap(Tbitmap w);
 
 #if defined(HAVE_SLOW_POPCOUNT)
 
 static inline uint
-popcount(Tbitmap w) {
+popcount32(uint32_t w) {
 	w -= (w >> 1) & 0x55555555;
 	w = (w & 0x33333333) + ((w >> 2) & 0x33333333);
 	w = (w + (w >> 4)) & 0x0F0F0F0F;
@@ -25,17 +37,69 @@ popcount(Tbitmap w) {
 #else
 
 static inline uint
-popcount(Tbitmap w) {
+popcount32(uint32_t w) {
 	return((uint)__builtin_popcount(w));
 }
 
 #endif
 
+static inline uint
+popcount(Tbitmap w) {
+#ifdef HAVE_BINARY_KEYS
+	return(popcount32((uint32_t)w) + (uint)(w >> 32));
+#else
+	return(popcount32(w));
+#endif
+}
+
+// Runtime CPU dispatch, see qp.h.
+
+#ifdef HAVE_TARGET_CLONES
+#define Tclones __attribute__((target_clones("popcnt", "default")))
+#else
+#define Tclones
+#endif
+
 typedef struct Tleaf {
 	const char *key;
 	void *val;
+#ifdef HAVE_BINARY_KEYS
+	size_t len;
+#endif
 } Tleaf;
 
+// With HAVE_RAW_VALUES the flags are in the top bits of the key
+// pointer instead of the bottom bits of the value; see qp.h.
+
+#if defined(HAVE_BINARY_KEYS) && defined(HAVE_RAW_VALUES)
+
+typedef struct Tbranch {
+	uint64_t index : 60,
+	         flags : 4;
+	union Trie *twigs;
+	Tbitmap bitmap;
+} Tbranch;
+
+#elif defined(HAVE_BINARY_KEYS)
+
+typedef struct Tbranch {
+	union Trie *twigs;
+	uint64_t flags : 4,
+	         index : 60;
+	Tbitmap bitmap;
+} Tbranch;
+
+#elif defined(HAVE_RAW_VALUES)
+
+typedef struct Tbranch {
+	uint32_t bitmap;
+	uint32_t index : 28,
+	         flags : 4;
+	union Trie *twigs;
+} Tbranch;
+
+#else
+
 typedef struct Tbranch {
 	union Trie *twigs;
 	uint32_t flags : 4,
@@ -43,6 +107,8 @@ typedef struct Tbranch {
 	uint32_t bitmap;
 } Tbranch;
 
+#endif
+
 typedef union Trie {
 	struct Tleaf   leaf;
 	struct Tbranch branch;
@@ -68,16 +134,29 @@ isbranch(Trie *t) {
 static inline Tbitmap
 nibbit(uint k, uint flags) {
 	uint shift = 16 - 5 - (flags >> 1);
+#ifdef HAVE_BINARY_KEYS
+	return((Tbitmap)2 << ((k >> shift) & 0x1FU));
+#else
 	return(1U << ((k >> shift) & 0x1FU));
+#endif
 }
 
 static inline Tbitmap
-twigbit(Trie *t, const char *key, size_t len) {
-	uint64_t i = t->branch.index;
+keybit(const char *key, size_t len, size_t i, uint flags) {
 	if(i >= len) return(1);
 	uint k = (byte)key[i] << 8;
+#ifdef HAVE_BINARY_KEYS
+	if(i+1 < len)
+		k |= (byte)key[i+1];
+#else
 	if(k) k |= (byte)key[i+1];
-	return(nibbit(k, t->branch.flags));
+#endif
+	return(nibbit(k, flags));
+}
+
+static inline Tbitmap
+twigbit(Trie *t, const char *key, size_t len) {
+	return(keybit(key, len, t->branch.index, t->branch.flags));
 }
 
 static inline bool
@@ -99,3 +178,60 @@ twig(Trie *t, uint i) {
 		off = twigoff(t, b);			\
 		max = popcount(t->branch.bitmap);	\
 	} while(0)
+
+// See qp.h for a description of the TWIG_SLACK size classes.
+
+#ifndef TWIG_SLACK
+#define TWIG_SLACK 0
+#endif
+
+static inline uint
+twigcap(uint m) {
+#if TWIG_SLACK == 2
+	return(m <= 2 ? 2 : 1U << (32 - __builtin_clz(m - 1)));
+#elif TWIG_SLACK == 1
+	return((m + 1) & ~1U);
+#else
+	return(m);
+#endif
+}
+
+// Leaf accessors that depend on whether keys are '\0' terminated.
+
+static inline void
+leafset(Trie *t, const char *key, size_t len, void *val) {
+	t->leaf.key = key;
+	t->leaf.val = val;
+#ifdef HAVE_BINARY_KEYS
+	t->leaf.len = len;
+#else
+	(void)len;
+#endif
+}
+
+#ifdef HAVE_BINARY_KEYS
+
+static inline size_t
+leaflen(Trie *t) {
+	return(t->leaf.len);
+}
+
+static inline bool
+leafmatch(Trie *t, const char *key, size_t len) {
+	return(len == t->leaf.len && memcmp(key, t->leaf.key, len) == 0);
+}
+
+#else
+
+static inline size_t
+leaflen(Trie *t) {
+	return(strlen(t->leaf.key));
+}
+
+static inline bool
+leafmatch(Trie *t, const char *key, size_t len) {
+	(void)len;
+	return(strcmp(key, t->leaf.key) == 0);
+}
+
+#endif
@@ -0,0 +1,174 @@
+// hamttest.c: test the HAMT-only table functions.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#define _WITH_GETLINE
+
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Tbl.h"
+#include "Thamt.h"
+
+static const char *progname;
+
+static void
+die(const char *cause) {
+	fprintf(stderr, "%s: %s: %s\n", progname, cause, strerror(errno));
+	exit(1);
+}
+
+static void
+fail(const char *what, const char *key, size_t len) {
+	fprintf(stderr, "%s: %s mismatch for %.*s\n",
+	    progname, what, (int)len, key);
+	exit(1);
+}
+
+static void
+usage(void) {
+	fprintf(stderr,
+"usage: %s <count> <input>\n"
+"	Load up to <count> keys from the input and check Twalk()\n"
+"	against Tnextl() and Tgetn() against Tgetl().\n"
+	    , progname);
+	exit(1);
+}
+
+// Twalk() should visit the same items in the same order as Tnextl(),
+// and stop when the callback returns false.
+
+typedef struct walkcheck {
+	Tbl *tbl;
+	const char *key;
+	size_t len, count, stop;
+} walkcheck;
+
+static bool
+walk_check(void *ctx, const char *key, size_t len, void *val) {
+	walkcheck *wc = ctx;
+	void *nval;
+	if(!Tnextl(wc->tbl, &wc->key, &wc->len, &nval) ||
+	   key != wc->key || len != wc->len || val != nval)
+		fail("Twalk", key, len);
+	wc->count += 1;
+	return(wc->count != wc->stop);
+}
+
+static void
+walk_test(Tbl *t, size_t n) {
+	walkcheck wc = { t, NULL, 0, 0, 0 };
+	if(!Twalk(t, walk_check, &wc) || wc.count != n)
+		fail("Twalk count", "", 0);
+	if(n == 0)
+		return;
+	wc = (walkcheck){ t, NULL, 0, 0, n / 2 + 1 };
+	if(Twalk(t, walk_check, &wc) || wc.count != wc.stop)
+		fail("Twalk stop", "", 0);
+}
+
+// Tgetn() should agree with Tgetl() for every key in the table, and
+// for every key without its first byte, which are mostly missing.
+// The batches have various sizes so that partial batches get tested.
+
+typedef struct collect {
+	const char **key;
+	size_t *len, count;
+} collect;
+
+static bool
+collect_key(void *ctx, const char *key, size_t len, void *val) {
+	collect *c = ctx;
+	(void)val;
+	c->key[c->count] = key;
+	c->len[c->count] = len;
+	c->count += 1;
+	return(true);
+}
+
+static void
+getn_test(Tbl *t, size_t n) {
+	const char **key = malloc(sizeof(*key) * (n + 1));
+	size_t *len = malloc(sizeof(*len) * (n + 1));
+	void **val = malloc(sizeof(*val) * (n + 1));
+	if(key == NULL || len == NULL || val == NULL)
+		die("malloc");
+	collect c = { key, len, 0 };
+	Twalk(t, collect_key, &c);
+	assert(c.count == n);
+	for(int miss = 0; miss < 2; miss++) {
+		for(size_t i = 0; miss && i < n; i++)
+			if(len[i] > 0)
+				key[i]++, len[i]--;
+		for(size_t i = 0, b = 0; i < n; i += b) {
+			b = 1 + i % 19;
+			if(b > n - i) b = n - i;
+			Tgetn(t, b, key + i, len + i, val + i);
+		}
+		for(size_t i = 0; i < n; i++)
+			if(val[i] != Tgetl(t, key[i], len[i]))
+				fail("Tgetn", key[i], len[i]);
+	}
+	free(key);
+	free(len);
+	free(val);
+}
+
+int
+main(int argc, char *argv[]) {
+	progname = argv[0];
+	if(argc != 3 || argv[1][0] == '-')
+		usage();
+	size_t max = (size_t)atol(argv[1]);
+	if(freopen(argv[2], "r", stdin) == NULL)
+		die("open");
+	// An empty table.
+	walk_test(NULL, 0);
+	getn_test(NULL, 0);
+	const char *nokey = "";
+	size_t nolen = 0;
+	void *noval = main;
+	Tgetn(NULL, 1, &nokey, &nolen, &noval);
+	if(noval != NULL)
+		fail("Tgetn", nokey, nolen);
+	Tbl *t = NULL;
+	size_t n = 0;
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+	while(n < max && (len = getline(&line, &size, stdin)) > 0) {
+		if(line[len-1] == '\n')
+			line[--len] = '\0';
+		if(Tgetl(t, line, (size_t)len) != NULL)
+			continue;
+		char *key = malloc((size_t)len + 1);
+		if(key == NULL)
+			die("malloc");
+		memcpy(key, line, (size_t)len + 1);
+		t = Tsetl(t, key, (size_t)len, key);
+		if(t == NULL)
+			die("Tbl");
+		n++;
+	}
+	free(line);
+	if(ferror(stdin))
+		die("read");
+	walk_test(t, n);
+	getn_test(t, n);
+	fprintf(stderr, "HAMT %zu keys ok\n", n);
+	const char *key = NULL;
+	size_t klen = 0;
+	void *val = NULL;
+	while(Tnextl(t, &key, &klen, &val)) {
+		t = Tdell(t, key, klen);
+		free(val);
+		key = NULL;
+	}
+	return(0);
+}
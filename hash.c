@@ -0,0 +1,285 @@
+// hash.c: hash functions for hash array mapped tries.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
+typedef unsigned char byte;
+typedef unsigned int uint;
+
+uint64_t
+hash_sip24(const char *key, size_t len) {
+	uint64_t h, k[2] = { 0, 0 };
+	siphash((void*)&h, (const void *)key, len, (void*)k);
+	return(h);
+}
+
+uint64_t
+hash_sip13(const char *key, size_t len) {
+	uint64_t h, k[2] = { 0, 0 };
+	siphash13((void*)&h, (const void *)key, len, (void*)k);
+	return(h);
+}
+
+// SipHash of four keys at once in the 64-bit lanes of AVX2 vectors.
+// Each key's blocks are fed into its lane in step with the others, and
+// a lane is left unchanged by the rounds after its last block. This
+// matches the siphash24.c reference for little-endian CPUs.
+
+#if defined(__x86_64__) && defined(__GNUC__)
+
+#define SIPROTL(x, b) \
+	_mm256_or_si256(_mm256_slli_epi64(x, b), _mm256_srli_epi64(x, 64 - b))
+#define SIPROTL32(x) \
+	_mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1))
+
+#define SIPROUND4 do {							\
+		v0 = _mm256_add_epi64(v0, v1);				\
+		v1 = SIPROTL(v1, 13);					\
+		v1 = _mm256_xor_si256(v1, v0);				\
+		v0 = SIPROTL32(v0);					\
+		v2 = _mm256_add_epi64(v2, v3);				\
+		v3 = SIPROTL(v3, 16);					\
+		v3 = _mm256_xor_si256(v3, v2);				\
+		v0 = _mm256_add_epi64(v0, v3);				\
+		v3 = SIPROTL(v3, 21);					\
+		v3 = _mm256_xor_si256(v3, v0);				\
+		v2 = _mm256_add_epi64(v2, v1);				\
+		v1 = SIPROTL(v1, 17);					\
+		v1 = _mm256_xor_si256(v1, v2);				\
+		v2 = SIPROTL32(v2);					\
+	} while(0)
+
+// The block of a key at index j, which is the final block with the
+// length and the leftover bytes when j is the number of whole blocks.
+
+static inline uint64_t
+sipblock(const char *key, size_t len, size_t j) {
+	uint64_t m = 0;
+	if(j < len / 8) {
+		memcpy(&m, key + j * 8, 8);
+	} else {
+		memcpy(&m, key + j * 8, len % 8);
+		m |= (uint64_t)len << 56;
+	}
+	return(m);
+}
+
+__attribute__((target("avx2")))
+static void
+sipx4_avx2(const char *const key[4], const size_t len[4], uint64_t h[4],
+    uint crounds, uint drounds) {
+	__m256i v0 = _mm256_set1_epi64x(0x736f6d6570736575LL);
+	__m256i v1 = _mm256_set1_epi64x(0x646f72616e646f6dLL);
+	__m256i v2 = _mm256_set1_epi64x(0x6c7967656e657261LL);
+	__m256i v3 = _mm256_set1_epi64x(0x7465646279746573LL);
+	size_t blocks = 0;
+	for(uint i = 0; i < 4; i++)
+		if(blocks < len[i] / 8)
+			blocks = len[i] / 8;
+	for(size_t j = 0; j <= blocks; j++) {
+		uint64_t m[4], live[4];
+		for(uint i = 0; i < 4; i++) {
+			live[i] = j <= len[i] / 8 ? ~0ULL : 0;
+			m[i] = live[i] ? sipblock(key[i], len[i], j) : 0;
+		}
+		__m256i mv = _mm256_loadu_si256((const __m256i *)m);
+		__m256i lv = _mm256_loadu_si256((const __m256i *)live);
+		__m256i o0 = v0, o1 = v1, o2 = v2, o3 = v3;
+		v3 = _mm256_xor_si256(v3, mv);
+		for(uint r = 0; r < crounds; r++)
+			SIPROUND4;
+		v0 = _mm256_xor_si256(v0, mv);
+		v0 = _mm256_blendv_epi8(o0, v0, lv);
+		v1 = _mm256_blendv_epi8(o1, v1, lv);
+		v2 = _mm256_blendv_epi8(o2, v2, lv);
+		v3 = _mm256_blendv_epi8(o3, v3, lv);
+	}
+	v2 = _mm256_xor_si256(v2, _mm256_set1_epi64x(0xff));
+	for(uint r = 0; r < drounds; r++)
+		SIPROUND4;
+	v0 = _mm256_xor_si256(_mm256_xor_si256(v0, v1),
+			      _mm256_xor_si256(v2, v3));
+	_mm256_storeu_si256((__m256i *)h, v0);
+}
+
+#define HAVE_SIPX4_AVX2 __builtin_cpu_supports("avx2")
+
+#else
+
+#define HAVE_SIPX4_AVX2 false
+#define sipx4_avx2(key, len, h, c, d) abort()
+
+#endif
+
+void
+hash_sip24x4(const char *const key[4], const size_t len[4], uint64_t h[4]) {
+	if(HAVE_SIPX4_AVX2)
+		sipx4_avx2(key, len, h, 2, 4);
+	else
+		for(uint i = 0; i < 4; i++)
+			h[i] = hash_sip24(key[i], len[i]);
+}
+
+void
+hash_sip13x4(const char *const key[4], const size_t len[4], uint64_t h[4]) {
+	if(HAVE_SIPX4_AVX2)
+		sipx4_avx2(key, len, h, 1, 3);
+	else
+		for(uint i = 0; i < 4; i++)
+			h[i] = hash_sip13(key[i], len[i]);
+}
+
+// wyhash, after Wang Yi's final version 4, with a zero seed.
+
+static inline void
+wymum(uint64_t *a, uint64_t *b) {
+#ifdef __SIZEOF_INT128__
+	__uint128_t r = (__uint128_t)*a * *b;
+	*a = (uint64_t)r;
+	*b = (uint64_t)(r >> 64);
+#else
+	uint64_t ha = *a >> 32, la = (uint32_t)*a;
+	uint64_t hb = *b >> 32, lb = (uint32_t)*b;
+	uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64_t t = rl + (rm0 << 32), c = t < rl;
+	uint64_t lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t
+wymix(uint64_t a, uint64_t b) {
+	wymum(&a, &b);
+	return(a ^ b);
+}
+
+static inline uint64_t
+wyr8(const byte *p) {
+	uint64_t v;
+	memcpy(&v, p, 8);
+	return(v);
+}
+
+static inline uint64_t
+wyr4(const byte *p) {
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return(v);
+}
+
+static inline uint64_t
+wyr3(const byte *p, size_t k) {
+	return(((uint64_t)p[0] << 16) | ((uint64_t)p[k >> 1] << 8) | p[k - 1]);
+}
+
+uint64_t
+hash_wy(const char *key, size_t len) {
+	static const uint64_t s[4] = {
+		0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL,
+		0x8ebc6af09c88c6e3ULL, 0x589965cc75374cc3ULL,
+	};
+	const byte *p = (const byte *)key;
+	uint64_t seed = wymix(s[0], s[1]), a, b;
+	if(len <= 16) {
+		if(len >= 4) {
+			size_t q = (len >> 3) << 2;
+			a = (wyr4(p) << 32) | wyr4(p + q);
+			b = (wyr4(p + len - 4) << 32) | wyr4(p + len - 4 - q);
+		} else if(len > 0) {
+			a = wyr3(p, len);
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		size_t i = len;
+		if(i > 48) {
+			uint64_t see1 = seed, see2 = seed;
+			do {
+				seed = wymix(wyr8(p) ^ s[1], wyr8(p+8) ^ seed);
+				see1 = wymix(wyr8(p+16) ^ s[2], wyr8(p+24) ^ see1);
+				see2 = wymix(wyr8(p+32) ^ s[3], wyr8(p+40) ^ see2);
+				p += 48; i -= 48;
+			} while(i > 48);
+			seed ^= see1 ^ see2;
+		}
+		while(i > 16) {
+			seed = wymix(wyr8(p) ^ s[1], wyr8(p+8) ^ seed);
+			p += 16; i -= 16;
+		}
+		a = wyr8(p + i - 16);
+		b = wyr8(p + i - 8);
+	}
+	a ^= s[1];
+	b ^= seed;
+	wymum(&a, &b);
+	return(wymix(a ^ s[0] ^ len, b ^ s[1]));
+}
+
+// CRC32C is only 32 bits, so it is spread over 64 bits with the
+// MurmurHash3 finalizer. It uses the SSE4.2 CRC32 instruction when the
+// CPU has it, and a slow bitwise loop otherwise.
+
+static uint32_t
+crc32c_sw(uint32_t crc, const byte *p, size_t len) {
+	while(len-- > 0) {
+		crc ^= *p++;
+		for(uint i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (0x82F63B78 & -(crc & 1));
+	}
+	return(crc);
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+
+__attribute__((target("sse4.2")))
+static uint32_t
+crc32c_hw(uint32_t crc, const byte *p, size_t len) {
+	uint64_t c = crc;
+	for(; len >= 8; p += 8, len -= 8)
+		c = __builtin_ia32_crc32di(c, wyr8(p));
+	crc = (uint32_t)c;
+	for(; len > 0; p++, len--)
+		crc = __builtin_ia32_crc32qi(crc, *p);
+	return(crc);
+}
+
+static inline uint32_t
+crc32c(uint32_t crc, const byte *p, size_t len) {
+	if(__builtin_cpu_supports("sse4.2"))
+		return(crc32c_hw(crc, p, len));
+	else
+		return(crc32c_sw(crc, p, len));
+}
+
+#else
+
+#define crc32c crc32c_sw
+
+#endif
+
+uint64_t
+hash_crc(const char *key, size_t len) {
+	uint64_t h = ~crc32c(~0U, (const byte *)key, len);
+	h ^= (uint64_t)len << 32;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return(h);
+}
@@ -0,0 +1,34 @@
+// hash.h: hash functions for hash array mapped tries.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+// A HAMT uses one of these for the first level of hashing, chosen at
+// compile time by defining HASH to its name. SipHash-2-4 is the
+// default; the others are faster for short keys but should only be
+// used with trusted keys: SipHash-1-3 has fewer rounds, wyhash is not
+// designed to resist attackers, and CRC32C is linear and only 32 bits.
+// They all hash with a fixed key or seed.
+
+extern int
+siphash(uint8_t *out, const uint8_t *in, uint64_t inlen, const uint8_t *k);
+
+extern int
+siphash13(uint8_t *out, const uint8_t *in, uint64_t inlen, const uint8_t *k);
+
+uint64_t hash_sip24(const char *key, size_t len);
+uint64_t hash_sip13(const char *key, size_t len);
+uint64_t hash_wy(const char *key, size_t len);
+uint64_t hash_crc(const char *key, size_t len);
+
+// Batched versions, which hash four keys at once. HASH4 is the batched
+// version of HASH if there is one.
+
+void hash_sip24x4(const char *const key[4], const size_t len[4], uint64_t h[4]);
+void hash_sip13x4(const char *const key[4], const size_t len[4], uint64_t h[4]);
+
+#ifndef HASH
+#define HASH hash_sip24
+#define HASH4 hash_sip24x4
+#endif
@@ -0,0 +1,88 @@
+// hat-debug.c: HAT-trie debug support
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Tbl.h"
+#include "hat.h"
+
+static void
+dump_rec(void *p, int d) {
+	if(isbox(p)) {
+		Tbox *b = tobox(p);
+		printf("Tdump%*s box %p count %u slots %u\n", d, "",
+		       b, b->count, b->slots);
+		for(uint i = 0; i < b->slots; i++) {
+			Tslot *s = b->slot[i];
+			if(s == NULL) continue;
+			printf("Tdump%*s slot %u size %zu\n", d, "", i, s->size);
+			byte *e = s->data, *end = s->data + s->size;
+			while(e < end) {
+				const byte *es;
+				size_t en;
+				byte *ep = entparse(e, &es, &en);
+				printf("Tdump%*s  suffix %.*s key %p %s val %p\n",
+				       d, "", (int)en, es, entkey(ep),
+				       entkey(ep), entval(ep));
+				e = ep + Tptrsize;
+			}
+		}
+	} else {
+		Tnode *node = p;
+		printf("Tdump%*s node %p\n", d, "", node);
+		for(uint c = 0; c < Tfanout; c++) {
+			if(node->child[c] == NULL) continue;
+			printf("Tdump%*s child %u\n", d, "", c);
+			dump_rec(node->child[c], d + 1);
+		}
+	}
+}
+
+void
+Tdump(Tbl *tbl) {
+	printf("Tdump root %p\n", tbl);
+	if(tbl != NULL)
+		dump_rec(tbl->root, 0);
+}
+
+static void
+size_rec(void *p, size_t d,
+    size_t *rsize, size_t *rdepth, size_t *rbranches, size_t *rleaves) {
+	if(isbox(p)) {
+		Tbox *b = tobox(p);
+		*rsize += boxsize(b->slots);
+		if(b->index != NULL)
+			*rsize += sizeof(Tkey) * b->count;
+		for(uint i = 0; i < b->slots; i++)
+			if(b->slot[i] != NULL)
+				*rsize += sizeof(Tslot) + b->slot[i]->size;
+		*rleaves += b->count;
+		*rdepth += d * b->count;
+	} else {
+		Tnode *node = p;
+		*rsize += sizeof(*node);
+		*rbranches += 1;
+		for(uint c = 0; c < Tfanout; c++)
+			if(node->child[c] != NULL)
+				size_rec(node->child[c], d + 1,
+				    rsize, rdepth, rbranches, rleaves);
+	}
+}
+
+void
+Tsize(Tbl *tbl, const char **rtype,
+    size_t *rsize, size_t *rdepth, size_t *rbranches, size_t *rleaves) {
+	*rtype = "ha";
+	*rsize = *rdepth = *rbranches = *rleaves = 0;
+	if(tbl != NULL) {
+		*rsize = sizeof(*tbl);
+		size_rec(tbl->root, 0, rsize, rdepth, rbranches, rleaves);
+	}
+}
@@ -0,0 +1,460 @@
+// hat.c: tables implemented with HAT-tries.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Tbl.h"
+#include "hat.h"
+
+static inline Tslot **
+slotfor(Tbox *b, const byte *sfx, size_t n) {
+	return(&b->slot[sfxhash(sfx, n) & (b->slots - 1)]);
+}
+
+// Find a suffix in a hash slot. Returns a pointer to the entry's key
+// and value pointers, or NULL, and sets *pent to the start of the entry.
+
+static byte *
+slotfind(Tslot *s, const byte *sfx, size_t n, byte **pent) {
+	if(s == NULL)
+		return(NULL);
+	byte *e = s->data, *end = s->data + s->size;
+	while(e < end) {
+		const byte *es;
+		size_t en;
+		byte *p = entparse(e, &es, &en);
+		if(en == n && memcmp(es, sfx, n) == 0) {
+			*pent = e;
+			return(p);
+		}
+		e = p + Tptrsize;
+	}
+	return(NULL);
+}
+
+static bool
+slotadd(Tslot **ps, const byte *sfx, size_t n, const char *key, void *val) {
+	Tslot *s = *ps;
+	size_t size = s == NULL ? 0 : s->size;
+	s = realloc(s, sizeof(Tslot) + size + entsize(n));
+	if(s == NULL) return(false);
+	entput(s->data + size, sfx, n, key, val);
+	s->size = size + entsize(n);
+	*ps = s;
+	return(true);
+}
+
+static Tbox *
+boxnew(uint slots) {
+	Tbox *b = calloc(1, boxsize(slots));
+	if(b == NULL) return(NULL);
+	b->slots = slots;
+	return(b);
+}
+
+static void
+boxfree(Tbox *b) {
+	for(uint i = 0; i < b->slots; i++)
+		free(b->slot[i]);
+	free(b->index);
+	free(b);
+}
+
+// Add an entry that is known to be absent.
+
+static bool
+boxadd(Tbox *b, const byte *sfx, size_t n, const char *key, void *val) {
+	if(!slotadd(slotfor(b, sfx, n), sfx, n, key, val))
+		return(false);
+	b->count++;
+	return(true);
+}
+
+static uint
+slotsfor(uint count) {
+	uint slots = Tminslots;
+	while(slots < Tmaxslots && slots * Tload < count)
+		slots *= 2;
+	return(slots);
+}
+
+// Rehash a container into twice as many slots. If allocation fails
+// the old container is returned unchanged.
+
+static Tbox *
+boxgrow(Tbox *b) {
+	Tbox *nb = boxnew(b->slots * 2);
+	if(nb == NULL) return(b);
+	for(uint i = 0; i < b->slots; i++) {
+		Tslot *s = b->slot[i];
+		if(s == NULL) continue;
+		byte *e = s->data, *end = s->data + s->size;
+		while(e < end) {
+			const byte *es;
+			size_t en;
+			byte *p = entparse(e, &es, &en);
+			if(!boxadd(nb, es, en, entkey(p), entval(p))) {
+				boxfree(nb);
+				return(b);
+			}
+			e = p + Tptrsize;
+		}
+	}
+	boxfree(b);
+	return(nb);
+}
+
+// Replace a full container with a node whose children are containers
+// for each first byte of the suffixes. Returns NULL if allocation
+// fails, leaving the old container unchanged.
+
+static Tnode *
+burst(Tbox *b) {
+	uint count[Tfanout] = { 0 };
+	for(uint i = 0; i < b->slots; i++) {
+		Tslot *s = b->slot[i];
+		if(s == NULL) continue;
+		byte *e = s->data, *end = s->data + s->size;
+		while(e < end) {
+			const byte *es;
+			size_t en;
+			byte *p = entparse(e, &es, &en);
+			count[en > 0 ? es[0] : 0] += 1;
+			e = p + Tptrsize;
+		}
+	}
+	Tnode *node = calloc(1, sizeof(*node));
+	if(node == NULL) return(NULL);
+	for(uint c = 0; c < Tfanout; c++) {
+		if(count[c] == 0) continue;
+		Tbox *cb = boxnew(slotsfor(count[c]));
+		if(cb == NULL) goto fail;
+		node->child[c] = boxptr(cb);
+	}
+	for(uint i = 0; i < b->slots; i++) {
+		Tslot *s = b->slot[i];
+		if(s == NULL) continue;
+		byte *e = s->data, *end = s->data + s->size;
+		while(e < end) {
+			const byte *es;
+			size_t en;
+			byte *p = entparse(e, &es, &en);
+			uint c = en > 0 ? es[0] : 0;
+			size_t d = childdepth(c, 0);
+			if(!boxadd(tobox(node->child[c]), es + d, en - d,
+				   entkey(p), entval(p)))
+				goto fail;
+			e = p + Tptrsize;
+		}
+	}
+	boxfree(b);
+	return(node);
+fail:
+	for(uint c = 0; c < Tfanout; c++)
+		if(node->child[c] != NULL)
+			boxfree(tobox(node->child[c]));
+	free(node);
+	return(NULL);
+}
+
+// Walk down the nodes to the child pointer for this key, which is
+// either NULL or a container, and set *pd to the depth of the key's
+// suffix in the container.
+
+static void **
+walk(Tbl *tbl, const char *key, size_t len, size_t *pd) {
+	void **pp = &tbl->root;
+	size_t d = 0;
+	while(*pp != NULL && !isbox(*pp)) {
+		Tnode *node = *pp;
+		uint c = childindex(key, len, d);
+		d = childdepth(c, d);
+		pp = &node->child[c];
+	}
+	*pd = d;
+	return(pp);
+}
+
+bool
+Tgetkv(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
+	if(tbl == NULL)
+		return(false);
+	size_t d;
+	void **pp = walk(tbl, key, len, &d);
+	if(*pp == NULL)
+		return(false);
+	Tbox *b = tobox(*pp);
+	const byte *sfx = (const byte *)key + d;
+	byte *e, *p = slotfind(*slotfor(b, sfx, len - d), sfx, len - d, &e);
+	if(p == NULL)
+		return(false);
+	*pkey = entkey(p);
+	*pval = entval(p);
+	return(true);
+}
+
+// Find the least entry in a container whose suffix is greater than
+// sfx, or the least entry if sfx is NULL, by scanning all of them.
+
+static bool
+boxscan(Tbox *b, size_t d, const byte *sfx, size_t n,
+    const char **pkey, size_t *plen, void **pval) {
+	const byte *best = NULL, *bsfx = NULL;
+	size_t bn = 0;
+	for(uint i = 0; i < b->slots; i++) {
+		Tslot *s = b->slot[i];
+		if(s == NULL) continue;
+		byte *e = s->data, *end = s->data + s->size;
+		while(e < end) {
+			const byte *es;
+			size_t en;
+			byte *p = entparse(e, &es, &en);
+			e = p + Tptrsize;
+			if(sfx != NULL && sfxcmp(es, en, sfx, n) <= 0)
+				continue;
+			if(best != NULL && sfxcmp(es, en, bsfx, bn) >= 0)
+				continue;
+			best = p; bsfx = es; bn = en;
+		}
+	}
+	if(best == NULL)
+		return(false);
+	*pkey = entkey(best);
+	*plen = d + bn;
+	*pval = entval(best);
+	return(true);
+}
+
+// The keys in a container all share their first d bytes, so the
+// index is sorted by whole keys, and searched by suffix.
+
+static int
+keyorder(const void *v1, const void *v2) {
+	const Tkey *k1 = v1, *k2 = v2;
+	return(sfxcmp((const byte *)k1->key, k1->len,
+		      (const byte *)k2->key, k2->len));
+}
+
+static bool
+boxindex(Tbox *b, size_t d) {
+	Tkey *k = malloc(sizeof(*k) * b->count);
+	if(k == NULL) return(false);
+	uint n = 0;
+	for(uint i = 0; i < b->slots; i++) {
+		Tslot *s = b->slot[i];
+		if(s == NULL) continue;
+		byte *e = s->data, *end = s->data + s->size;
+		while(e < end) {
+			const byte *es;
+			size_t en;
+			byte *p = entparse(e, &es, &en);
+			k[n].key = entkey(p);
+			k[n].len = d + en;
+			n++;
+			e = p + Tptrsize;
+		}
+	}
+	qsort(k, n, sizeof(*k), keyorder);
+	b->index = k;
+	return(true);
+}
+
+// The position in the index of the first key whose suffix is greater
+// than sfx.
+
+static uint
+indexnext(Tbox *b, size_t d, const byte *sfx, size_t n) {
+	uint lo = 0, hi = b->count;
+	while(lo < hi) {
+		uint mid = lo + (hi - lo) / 2;
+		Tkey *k = &b->index[mid];
+		if(sfxcmp((const byte *)k->key + d, k->len - d, sfx, n) <= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return(lo);
+}
+
+static bool
+boxnext(Tbox *b, size_t d, const byte *sfx, size_t n,
+    const char **pkey, size_t *plen, void **pval) {
+	if(b->index == NULL && !boxindex(b, d))
+		return(boxscan(b, d, sfx, n, pkey, plen, pval));
+	uint i = sfx == NULL ? 0 : indexnext(b, d, sfx, n);
+	if(i == b->count)
+		return(false);
+	const byte *ks = (const byte *)b->index[i].key + d;
+	size_t kn = b->index[i].len - d;
+	byte *e, *p = slotfind(*slotfor(b, ks, kn), ks, kn, &e);
+	*pkey = entkey(p);
+	*plen = d + kn;
+	*pval = entval(p);
+	return(true);
+}
+
+static bool
+next_rec(void *p, size_t d, const char *key, size_t len,
+    const char **pkey, size_t *plen, void **pval) {
+	if(p == NULL)
+		return(false);
+	if(isbox(p)) {
+		if(key == NULL)
+			return(boxnext(tobox(p), d, NULL, 0, pkey, plen, pval));
+		return(boxnext(tobox(p), d, (const byte *)key + d, len - d,
+			       pkey, plen, pval));
+	}
+	Tnode *node = p;
+	uint c = 0;
+	// Look for the next key below this key's child, then for the
+	// first key below the following children.
+	if(key != NULL) {
+		c = childindex(key, len, d);
+		if(next_rec(node->child[c], childdepth(c, d), key, len,
+			    pkey, plen, pval))
+			return(true);
+		c++;
+	}
+	for(; c < Tfanout; c++)
+		if(next_rec(node->child[c], childdepth(c, d), NULL, 0,
+			    pkey, plen, pval))
+			return(true);
+	return(false);
+}
+
+bool
+Tnextl(Tbl *tbl, const char **pkey, size_t *plen, void **pval) {
+	if(tbl != NULL &&
+	   next_rec(tbl->root, 0, *pkey, *plen, pkey, plen, pval))
+		return(true);
+	*pkey = NULL;
+	*plen = 0;
+	return(false);
+}
+
+static void
+free_rec(void *p) {
+	if(p == NULL)
+		return;
+	if(isbox(p)) {
+		boxfree(tobox(p));
+		return;
+	}
+	Tnode *node = p;
+	for(uint c = 0; c < Tfanout; c++)
+		free_rec(node->child[c]);
+	free(node);
+}
+
+void
+Tfree(Tbl *tbl) {
+	if(tbl == NULL)
+		return;
+	free_rec(tbl->root);
+	free(tbl);
+}
+
+Tbl *
+Tdelkv(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
+	if(tbl == NULL)
+		return(NULL);
+	size_t d;
+	void **pp = walk(tbl, key, len, &d);
+	if(*pp == NULL)
+		return(tbl);
+	Tbox *b = tobox(*pp);
+	const byte *sfx = (const byte *)key + d;
+	Tslot **ps = slotfor(b, sfx, len - d);
+	byte *e, *p = slotfind(*ps, sfx, len - d, &e);
+	if(p == NULL)
+		return(tbl);
+	*pkey = entkey(p);
+	*pval = entval(p);
+	if(--tbl->count == 0) {
+		Tfree(tbl);
+		return(NULL);
+	}
+	Tslot *s = *ps;
+	byte *next = p + Tptrsize, *end = s->data + s->size;
+	memmove(e, next, (size_t)(end - next));
+	s->size -= (size_t)(next - e);
+	if(b->index != NULL) {
+		uint i = indexnext(b, d, sfx, len - d) - 1;
+		memmove(&b->index[i], &b->index[i+1],
+			sizeof(Tkey) * (b->count - i - 1));
+	}
+	if(--b->count == 0) {
+		boxfree(b);
+		*pp = NULL;
+	} else if(s->size == 0) {
+		free(s);
+		*ps = NULL;
+	} else {
+		// If realloc() fails we keep the oversized slot.
+		s = realloc(s, sizeof(Tslot) + s->size);
+		if(s != NULL) *ps = s;
+	}
+	return(tbl);
+}
+
+Tbl *
+Tsetl(Tbl *tbl, const char *key, size_t len, void *val) {
+	if(val == NULL)
+		return(Tdell(tbl, key, len));
+	// First key in an empty tbl?
+	if(tbl == NULL) {
+		tbl = malloc(sizeof(*tbl));
+		if(tbl == NULL) return(NULL);
+		Tbox *b = boxnew(Tminslots);
+		if(b == NULL) {
+			free(tbl);
+			return(NULL);
+		}
+		tbl->root = boxptr(b);
+		tbl->count = 0;
+	}
+	size_t d;
+	void **pp = walk(tbl, key, len, &d);
+	if(*pp == NULL) {
+		Tbox *b = boxnew(Tminslots);
+		if(b == NULL) return(NULL);
+		*pp = boxptr(b);
+	}
+	Tbox *b = tobox(*pp);
+	const byte *sfx = (const byte *)key + d;
+	Tslot **ps = slotfor(b, sfx, len - d);
+	byte *e, *p = slotfind(*ps, sfx, len - d, &e);
+	if(p != NULL) {
+		entsetval(p, val);
+		return(tbl);
+	}
+	if(!slotadd(ps, sfx, len - d, key, val)) {
+		// Undo the allocation of a new container or table.
+		if(b->count == 0) {
+			boxfree(b);
+			*pp = NULL;
+		}
+		if(tbl->count == 0)
+			free(tbl);
+		return(NULL);
+	}
+	b->count++;
+	tbl->count++;
+	free(b->index);
+	b->index = NULL;
+	// The key is in the table now, so if growing the container
+	// fails we can ignore it and carry on with the old one.
+	if(b->count > Tburst) {
+		Tnode *node = burst(b);
+		if(node != NULL) *pp = node;
+	} else if(b->count > b->slots * Tload) {
+		*pp = boxptr(boxgrow(b));
+	}
+	return(tbl);
+}
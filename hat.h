@@ -0,0 +1,193 @@
+// hat.h: tables implemented with HAT-tries.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+// A HAT-trie (Askitis and Sinha) is a burst trie whose containers are
+// cache-conscious array hash tables. The top of the trie is made of
+// nodes that consume one byte of the key each, with an array of 256
+// child pointers indexed by that byte. The leaves of the trie are
+// containers that hold the rest of each key (its suffix) in a small
+// hash table. A hash slot is not a linked list but a single
+// allocation, with the entries packed end to end, so a lookup scans
+// a few contiguous bytes instead of chasing a pointer per key.
+//
+// An entry is the suffix's length (in LEB128), the suffix bytes, then
+// the caller's key pointer and the value pointer, unaligned. The
+// suffix is a copy so that a lookup does not touch the caller's key.
+//
+// A container grows its number of hash slots as it fills, up to
+// Tmaxslots, and when it has more than Tburst entries it bursts: it is
+// replaced by a node whose children are new containers, one for each
+// distinct first byte of the suffixes. A key that ends at a node is
+// kept in the container at index 0, which holds at most one key. Nodes
+// are not merged back into containers when keys are deleted.
+//
+// The hash slots are not in order, so when Tnextl() first reaches a
+// container it sorts an index of the container's keys, which it then
+// binary searches for the successor of the previous key, so a
+// complete walk costs O(n log Tburst) comparisons. The index holds the
+// caller's key pointers, which stay valid while their keys are in the
+// table. A delete removes its key from the index; an insert frees the
+// index, so a table that is not being walked does not pay for it. If
+// the index cannot be allocated, Tnextl() scans the container instead.
+//
+// Only C string keys are supported.
+
+typedef unsigned char byte;
+typedef unsigned int uint;
+
+#define Tfanout    256
+#define Tminslots  4
+#define Tmaxslots  256
+#define Tload      4
+#define Tburst     (Tmaxslots * Tload)
+
+typedef struct Tslot {
+	size_t size;
+	byte data[];
+} Tslot;
+
+typedef struct Tkey {
+	const char *key;
+	size_t len;
+} Tkey;
+
+typedef struct Tbox {
+	uint count, slots;
+	Tkey *index;
+	Tslot *slot[];
+} Tbox;
+
+// A child pointer is NULL, a node, or a container with its bottom bit
+// set.
+
+typedef struct Tnode {
+	void *child[Tfanout];
+} Tnode;
+
+struct Tbl {
+	void *root;
+	size_t count;
+};
+
+static inline bool
+isbox(void *p) {
+	return((uintptr_t)p & 1);
+}
+
+static inline Tbox *
+tobox(void *p) {
+	return((Tbox *)((uintptr_t)p - 1));
+}
+
+static inline void *
+boxptr(Tbox *b) {
+	return((void *)((uintptr_t)b + 1));
+}
+
+static inline size_t
+boxsize(uint slots) {
+	return(sizeof(Tbox) + sizeof(Tslot *) * slots);
+}
+
+// The child index for the byte at depth d, and the depth below it. A
+// key that ends at this node stays at the same depth, with an empty
+// suffix.
+
+static inline uint
+childindex(const char *key, size_t len, size_t d) {
+	return(d < len ? (byte)key[d] : 0);
+}
+
+static inline size_t
+childdepth(uint c, size_t d) {
+	return(c == 0 ? d : d + 1);
+}
+
+// Entries in a hash slot.
+
+#define Tptrsize (2 * sizeof(void *))
+
+static inline size_t
+varintsize(size_t n) {
+	size_t s = 1;
+	while(n >= 0x80)
+		n >>= 7, s++;
+	return(s);
+}
+
+static inline size_t
+entsize(size_t n) {
+	return(varintsize(n) + n + Tptrsize);
+}
+
+// Parse the entry at e, returning a pointer to its key and value
+// pointers, which are followed by the next entry.
+
+static inline byte *
+entparse(byte *e, const byte **psfx, size_t *plen) {
+	size_t n = 0;
+	uint shift = 0;
+	do {
+		n |= (size_t)(*e & 0x7F) << shift;
+		shift += 7;
+	} while(*e++ & 0x80);
+	*psfx = e;
+	*plen = n;
+	return(e + n);
+}
+
+static inline byte *
+entput(byte *e, const byte *sfx, size_t n, const char *key, void *val) {
+	size_t v = n;
+	while(v >= 0x80) {
+		*e++ = (byte)(v | 0x80);
+		v >>= 7;
+	}
+	*e++ = (byte)v;
+	memcpy(e, sfx, n);
+	e += n;
+	memcpy(e, &key, sizeof(key));
+	memcpy(e + sizeof(key), &val, sizeof(val));
+	return(e + Tptrsize);
+}
+
+static inline const char *
+entkey(const byte *p) {
+	const char *key;
+	memcpy(&key, p, sizeof(key));
+	return(key);
+}
+
+static inline void *
+entval(const byte *p) {
+	void *val;
+	memcpy(&val, p + sizeof(const char *), sizeof(val));
+	return(val);
+}
+
+static inline void
+entsetval(byte *p, void *val) {
+	memcpy(p + sizeof(const char *), &val, sizeof(val));
+}
+
+// Compare suffixes in the same order as the whole keys.
+
+static inline int
+sfxcmp(const byte *s1, size_t n1, const byte *s2, size_t n2) {
+	int r = memcmp(s1, s2, n1 < n2 ? n1 : n2);
+	if(r != 0) return(r);
+	return(n1 < n2 ? -1 : n1 > n2 ? +1 : 0);
+}
+
+// FNV-1a, which is cheap for short suffixes.
+
+static inline uint
+sfxhash(const byte *s, size_t n) {
+	uint32_t h = 0x811C9DC5;
+	for(size_t i = 0; i < n; i++)
+		h = (h ^ s[i]) * 0x01000193;
+	return(h ^ (h >> 16));
+}
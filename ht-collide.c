@@ -0,0 +1,58 @@
+// ht-collide.c: adversarial keys for hash array mapped tries.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+// Print keys whose first hash values, as used by ht.c, agree in their
+// low bits, so that they all share the same path through the
+// top levels of the trie. This is what an attacker who knows the hash
+// key could do to make a HAMT degenerate.
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+
+static const char *progname;
+
+static void
+usage(void) {
+	fprintf(stderr,
+"usage: %s <bits> <count>\n"
+"	Print <count> keys whose hashes agree in their low <bits>\n"
+"	bits. Each key costs about 2^<bits> hashes to find.\n"
+		, progname);
+	exit(1);
+}
+
+int
+main(int argc, char *argv[]) {
+	progname = argv[0];
+	if(argc != 3)
+		usage();
+	int bits = atoi(argv[1]);
+	long count = atol(argv[2]);
+	if(bits < 0 || bits > 32 || count < 0)
+		usage();
+	uint64_t mask = ((uint64_t)1 << bits) - 1, want = 0;
+	char key[32];
+	for(unsigned long i = 0; count > 0; i++) {
+		int len = snprintf(key, sizeof(key), "collide-%lu", i);
+		uint64_t h = HASH(key, (size_t)len) & mask;
+		if(i == 0)
+			want = h;
+		if(h != want)
+			continue;
+		puts(key);
+		count--;
+	}
+	if(fflush(stdout) != 0) {
+		fprintf(stderr, "%s: write: %s\n", progname, strerror(errno));
+		exit(1);
+	}
+	return(0);
+}
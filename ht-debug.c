@@ -9,6 +9,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "Tbl.h"
 #include "ht.h"
@@ -17,8 +18,8 @@ static void
 dump_rec(Trie *t, int d) {
 	if(isbranch(t)) {
 		printf("Tdump%*s branch %p\n", d, "", t);
-		for(uint i = 0; i < 64; i++) {
-			uint64_t b = twigbit(i);
+		for(uint i = 0; i < lgN; i++) {
+			uintptr_t b = twigbit(i);
 			if(hastwig(t, b)) {
 				printf("Tdump%*s twig %d\n", d, "", i);
 				dump_rec(twig(t, twigoff(t, b)), d+1);
@@ -36,19 +37,31 @@ dump_rec(Trie *t, int d) {
 void
 Tdump(Tbl *tbl) {
 	printf("Tdump root %p\n", tbl);
-	if(tbl != NULL)
-		dump_rec(&tbl->root, 0);
+	if(tbl == NULL)
+		return;
+	for(size_t i = 0; i < roots(tbl); i++) {
+		Trie *t = root(tbl, i);
+		if(isempty(t))
+			continue;
+		if(roots(tbl) > 1)
+			printf("Tdump slot %zu\n", i);
+		dump_rec(t, 0);
+	}
 }
 
 static void
-size_rec(Trie *t, uint d, size_t *rsize, size_t *rdepth, size_t *rleaves) {
+size_rec(Trie *t, uint d,
+    size_t *rsize, size_t *rdepth, size_t *rbranches, size_t *rleaves) {
 	*rsize += sizeof(*t);
 	if(isbranch(t)) {
-		for(uint i = 0; i < 64; i++) {
-			uint64_t b = twigbit(i);
+		// A single-twig branch must have a branch below it.
+		assert(twigmax(t) > 1 || isbranch(twig(t, 0)));
+		*rbranches += 1;
+		for(uint i = 0; i < lgN; i++) {
+			uintptr_t b = twigbit(i);
 			if(hastwig(t, b))
 				size_rec(twig(t, twigoff(t, b)), d+1,
-					 rsize, rdepth, rleaves);
+				    rsize, rdepth, rbranches, rleaves);
 		}
 	} else {
 		*rdepth += d;
@@ -58,9 +71,19 @@ size_rec(Trie *t, uint d, size_t *rsize, size_t *rdepth, size_t *rleaves) {
 
 void
 Tsize(Tbl *tbl, const char **rtype,
-      size_t *rsize, size_t *rdepth, size_t *rleaves) {
+    size_t *rsize, size_t *rdepth, size_t *rbranches, size_t *rleaves) {
 	*rtype = "ht";
-	*rsize = *rdepth = *rleaves = 0;
-	if(tbl != NULL)
-		size_rec(tbl, 0, rsize, rdepth, rleaves);
+	*rsize = *rdepth = *rbranches = *rleaves = 0;
+	if(tbl == NULL)
+		return;
+#ifdef HAVE_ROOT_ARRAY
+	*rsize += sizeof(*tbl);
+#endif
+	for(size_t i = 0; i < roots(tbl); i++) {
+		Trie *t = root(tbl, i);
+		if(isempty(t))
+			*rsize += sizeof(*t);
+		else
+			size_rec(t, 0, rsize, rdepth, rbranches, rleaves);
+	}
 }
@@ -1,4 +1,4 @@
-// qp.c: tables implemented with hash array mapped tries
+// ht.c: tables implemented with hash array mapped tries
 //
 // Written by Tony Finch <dot@dotat.at>
 // You may do anything with this. It has no warranty.
@@ -12,67 +12,193 @@
 #include <string.h>
 
 #include "Tbl.h"
+#include "Thamt.h"
+#include "hash.h"
 #include "ht.h"
 
 static inline uint64_t
 hash(const char *key, size_t len, uint depth) {
 	uint64_t h, stir[2] = { depth, depth };
-	siphash((void*)&h, (const void *)key, len, (void*)stir);
+	if(depth == 0)
+		h = HASH(key, len);
+	else
+		siphash((void*)&h, (const void *)key, len, (void*)stir);
+#ifdef HASH_MASK
+	h &= HASH_MASK;
+#endif
 	return(h);
 }
 
+// Each trie level consumes the next lglgN bits of the key's hash. When
+// a hash value runs out, the key is hashed again with the next depth
+// as the SipHash key, so two different keys are eventually separated
+// however many of their hash bits collide.
+
+typedef struct Hcursor {
+	const char *key;
+	size_t len;
+	uint64_t h;
+	uint d1, d2;
+} Hcursor;
+
+// The length of a key is only needed to rehash it (C string keys are
+// compared without it) so a cursor made from a cached hash does not
+// look at the key until then.
+#define Hnolen SIZE_MAX
+
+static inline Hcursor
+hcursor(const char *key, size_t len, uint d1, uint d2) {
+	Hcursor c = { key, len, hash(key, len, d1) >> d2, d1, d2 };
+	return(c);
+}
+
+// A cursor for the existing leaf t at the same position as a new key,
+// which does not need to touch t's key if its hash is in the leaf.
+
+static inline Hcursor
+hleaf(Trie *t, uint d1, uint d2) {
+	const char *key = t->leaf.key;
+#ifdef HAVE_HASH_CACHE
+	if(d1 == 0) {
+#ifdef HAVE_BINARY_KEYS
+		Hcursor c = { key, leaflen(t), t->leaf.hash >> d2, d1, d2 };
+#else
+		Hcursor c = { key, Hnolen, t->leaf.hash >> d2, d1, d2 };
+#endif
+		return(c);
+	}
+#endif
+	return(hcursor(key, leaflen(t), d1, d2));
+}
+
+static inline uintptr_t
+hbit(Hcursor *c) {
+	return(twigbit(c->h));
+}
+
+static inline void
+hnext(Hcursor *c) {
+	c->h >>= lglgN;
+	c->d2 += lglgN;
+	if(c->d2 + lglgN > Hbits) {
+		size_t len = c->len != Hnolen ? c->len : strlen(c->key);
+		*c = hcursor(c->key, len, c->d1 + 1, 0);
+	}
+}
+
 bool
 Tgetkv(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
 	if(tbl == NULL)
 		return(false);
-	Trie *t = &tbl->root;
-	for(uint d1 = 0 ;; ++d1) {
-		uint64_t h = hash(key, len, d1);
-		for(uint d2 = lglgN; d2 < Hbits; d2 += lglgN, h >>= lglgN) {
-			if(!isbranch(t))
-				goto leaf;
-			uintptr_t b = twigbit(h);
-			if(!hastwig(t, b))
-				return(false);
-			t = twig(t, twigoff(t, b));
-		}
+	Hcursor c = hcursor(key, len, 0, 0);
+	uint64_t h = c.h;
+	Trie *t = root(tbl, rootindex(tbl, h));
+	if(isempty(t))
+		return(false);
+	while(isbranch(t)) {
+		uintptr_t b = hbit(&c);
+		if(!hastwig(t, b))
+			return(false);
+		t = twig(t, twigoff(t, b));
+		hnext(&c);
 	}
-leaf:	if(strcmp(key, t->leaf.key) != 0)
+	if(!leafmatch(t, key, len, h))
 		return(false);
 	*pkey = t->leaf.key;
 	*pval = t->leaf.val;
 	return(true);
 }
 
+// Hash four keys at once for a batch lookup.
+
+static inline void
+hash4(const char *const key[4], const size_t len[4], uint64_t h[4]) {
+#ifdef HASH4
+	HASH4(key, len, h);
+#else
+	for(uint i = 0; i < 4; i++)
+		h[i] = HASH(key[i], len[i]);
+#endif
+#ifdef HASH_MASK
+	for(uint i = 0; i < 4; i++)
+		h[i] &= HASH_MASK;
+#endif
+}
+
+void
+Tgetn(Tbl *tbl, size_t n, const char *const keys[], const size_t lens[], void *vals[]) {
+	if(tbl == NULL) {
+		memset(vals, 0, sizeof(*vals) * n);
+		return;
+	}
+	for(size_t i = 0; i < n; i += Hbatch) {
+		uint m = n - i < Hbatch ? (uint)(n - i) : Hbatch;
+		// A short batch is padded with copies of its first key.
+		const char *key[Hbatch];
+		size_t len[Hbatch];
+		for(uint j = 0; j < Hbatch; j++) {
+			key[j] = keys[i + (j < m ? j : 0)];
+			len[j] = lens[i + (j < m ? j : 0)];
+		}
+		uint64_t h[Hbatch];
+		for(uint j = 0; j < m; j += 4)
+			hash4(key + j, len + j, h + j);
+		Hcursor c[Hbatch];
+		Trie *t[Hbatch];
+		for(uint j = 0; j < m; j++) {
+			c[j] = (Hcursor){ key[j], len[j], h[j], 0, 0 };
+			t[j] = root(tbl, rootindex(tbl, h[j]));
+			if(isempty(t[j])) t[j] = NULL;
+		}
+		// Walk down the tries in step, so that the next twig for
+		// each key is prefetched while the others are examined.
+		for(bool more = true; more; ) {
+			more = false;
+			for(uint j = 0; j < m; j++) {
+				if(t[j] == NULL || !isbranch(t[j]))
+					continue;
+				uintptr_t b = hbit(&c[j]);
+				if(!hastwig(t[j], b)) {
+					t[j] = NULL;
+					continue;
+				}
+				t[j] = twig(t[j], twigoff(t[j], b));
+				__builtin_prefetch(t[j]);
+				hnext(&c[j]);
+				more = true;
+			}
+		}
+		for(uint j = 0; j < m; j++)
+			vals[i + j] = t[j] != NULL && leafmatch(t[j], key[j], len[j], h[j])
+				? t[j]->leaf.val : NULL;
+	}
+}
+
+// The cursor follows *pkey until it is found, after which the search
+// takes the first twig of each branch.
+
 static bool
-next_rec(Trie *t, const char **pkey, size_t *plen, void **pval,
-	 uint64_t h, uint d1, uint d2) {
+next_rec(Trie *t, const char **pkey, size_t *plen, void **pval, Hcursor c) {
 	if(isbranch(t)) {
-		if(d2 >= Hbits) {
-			h = *pkey == NULL ? 0 :
-				hash(*pkey, *plen, d1++);
-			d2 = lglgN;
+		uint s = 0, m = twigmax(t);
+		if(*pkey != NULL) {
+			s = twigoff(t, hbit(&c));
+			hnext(&c);
 		}
-		uintptr_t b = twigbit(h);
-		uint s = twigoff(t, b);
-		uint m = twigmax(t);
 		for(; s < m; s++)
-			if(next_rec(twig(t, s), pkey, plen, pval,
-				    h >> lglgN, d1, d2 + lglgN))
+			if(next_rec(twig(t, s), pkey, plen, pval, c))
 				return(true);
-			else
-				h = 0;
 		return(false);
 	}
 	// We have found the next leaf.
 	if(*pkey == NULL) {
 		*pkey = t->leaf.key;
-		*plen = strlen(*pkey);
+		*plen = leaflen(t);
 		*pval = t->leaf.val;
 		return(true);
 	}
 	// We have found this leaf, so start looking for the next one.
-	if(strcmp(*pkey, t->leaf.key) == 0) {
+	if(keymatch(t, *pkey, *plen)) {
 		*pkey = NULL;
 		*plen = 0;
 		return(false);
@@ -88,45 +214,146 @@ Tnextl(Tbl *tbl, const char **pkey, size_t *plen, void **pval) {
 		*plen = 0;
 		return(NULL);
 	}
-	return(next_rec(&tbl->root, pkey, plen, pval, 0, 0, Hbits));
+	// A NULL key is never hashed, so its cursor is unused.
+	Hcursor c = { NULL, 0, 0, 0, 0 };
+	size_t i = 0;
+	if(*pkey != NULL) {
+		c = hcursor(*pkey, *plen, 0, 0);
+		i = rootindex(tbl, c.h);
+	}
+	for(; i < roots(tbl); i++) {
+		Trie *t = root(tbl, i);
+		if(!isempty(t) && next_rec(t, pkey, plen, pval, c))
+			return(true);
+	}
+	return(false);
+}
+
+static bool
+walk_rec(Trie *t, Twalkfn *fn, void *ctx) {
+	if(!isbranch(t))
+		return(fn(ctx, t->leaf.key, leaflen(t), t->leaf.val));
+	uint m = twigmax(t);
+	for(uint i = 0; i < m; i++)
+		if(!walk_rec(twig(t, i), fn, ctx))
+			return(false);
+	return(true);
+}
+
+bool
+Twalk(Tbl *tbl, Twalkfn *fn, void *ctx) {
+	if(tbl == NULL)
+		return(true);
+	for(size_t i = 0; i < roots(tbl); i++) {
+		Trie *t = root(tbl, i);
+		if(!isempty(t) && !walk_rec(t, fn, ctx))
+			return(false);
+	}
+	return(true);
+}
+
+static void
+free_rec(Trie *t) {
+	if(!isbranch(t))
+		return;
+	uint m = twigmax(t);
+	for(uint i = 0; i < m; i++)
+		free_rec(twig(t, i));
+	free(twig(t, 0));
+}
+
+void
+Tfree(Tbl *tbl) {
+	if(tbl == NULL)
+		return;
+	for(size_t i = 0; i < roots(tbl); i++)
+		free_rec(root(tbl, i));
+#ifdef HAVE_ROOT_ARRAY
+	free(tbl->slot);
+#endif
+	free(tbl);
+}
+
+// Free the twig arrays of a chain of single-twig branches from t down
+// to (but not including) the twig array of the branch at p.
+
+static void
+free_chain(Trie *t, Trie *p) {
+	for(Trie *q = t; q != p; ) {
+		Trie *next = twig(q, 0);
+		if(q != t) free(q);
+		q = next;
+	}
+	if(p != t) free(p);
+}
+
+// Count a deleted key.
+
+static inline Tbl *
+removed(Tbl *tbl) {
+#ifdef HAVE_ROOT_ARRAY
+	if(--tbl->count == 0) {
+		Tfree(tbl);
+		return(NULL);
+	}
+#endif
+	return(tbl);
 }
 
 Tbl *
 Tdelkv(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
 	if(tbl == NULL)
 		return(NULL);
-	Trie *t = &tbl->root, *p = NULL;
-	uint64_t h = 0;
+	// Keys whose hashes collide are separated by chains of
+	// single-twig branches. Keep track of the top of the chain
+	// above the leaf's parent so that we can unsplice it.
+	Hcursor c = hcursor(key, len, 0, 0);
+	uint64_t h = c.h;
+	Trie *t = root(tbl, rootindex(tbl, h)), *p = NULL, *top = NULL;
 	uintptr_t b = 0;
-	for(uint d1 = 0 ;; ++d1) {
-		h = hash(key, len, d1);
-		for(uint d2 = lglgN; d2 < Hbits; d2 += lglgN, h >>= lglgN) {
-			if(!isbranch(t))
-				goto leaf;
-			b = twigbit(h);
-			if(!hastwig(t, b))
-				return(tbl);
-			p = t; t = twig(t, twigoff(t, b));
+	if(isempty(t))
+		return(tbl);
+	while(isbranch(t)) {
+		b = hbit(&c);
+		if(!hastwig(t, b))
+			return(tbl);
+		if(p != NULL && twigmax(p) == 1) {
+			if(top == NULL) top = p;
+		} else {
+			top = NULL;
 		}
+		p = t; t = twig(t, twigoff(t, b));
+		hnext(&c);
 	}
-leaf:	if(strcmp(key, t->leaf.key) != 0)
+	if(!leafmatch(t, key, len, h))
 		return(tbl);
 	*pkey = t->leaf.key;
 	*pval = t->leaf.val;
 	if(p == NULL) {
+#ifdef HAVE_ROOT_ARRAY
+		memset(t, 0, sizeof(*t));
+		return(removed(tbl));
+#else
 		free(tbl);
 		return(NULL);
+#endif
 	}
 	t = p; p = NULL; // Becuase t is the usual name
 	uint s = twigoff(t, b), m = twigmax(t);
-	if(m == 2) {
-		// Move the other twig to the parent branch.
-		// XXX: May need to unsplice deep hash collision here.
+	// A single-twig branch always has a branch below it, because a
+	// leaf can move up to replace it.
+	assert(m >= 2);
+	if(m == 2 && !isbranch(twig(t, !s))) {
+		// Move the other leaf up to the top of the chain.
+		if(top == NULL) top = t;
+		Trie leaf = *twig(t, !s);
 		Trie *twigs = twig(t, 0);
-		*t = *twig(t, !s);
+		free_chain(top, t);
 		free(twigs);
-		return(tbl);
+		*top = leaf;
+		return(removed(tbl));
 	}
+	// Otherwise this branch remains, perhaps with a single twig.
 	Trie *twigs = malloc(sizeof(Trie) * (m - 1));
 	if(twigs == NULL) return(NULL);
 	memcpy(twigs, twig(t, 0), sizeof(Trie) * s);
@@ -134,6 +361,132 @@ leaf:	if(strcmp(key, t->leaf.key) != 0)
 	free(twig(t, 0));
 	twigset(t, twigs);
 	t->branch.map &= ~b;
+	return(removed(tbl));
+}
+
+// Add the leaf t1 to the trie t, which is not empty, or replace the
+// value of its key. The cursor c1 is for t1's key, at t's position.
+// Returns 1 if the key was added, 0 if its value was replaced, or -1 if
+// allocation failed, leaving the trie unchanged.
+
+static int
+insert(Trie *t, Trie t1, Hcursor c1, uint64_t h) {
+	uintptr_t b1;
+	while(isbranch(t)) {
+		b1 = hbit(&c1);
+		if(!hastwig(t, b1))
+			goto growbranch;
+		t = twig(t, twigoff(t, b1));
+		hnext(&c1);
+	}
+	if(leafmatch(t, t1.leaf.key, c1.len, h)) {
+		t->leaf.val = t1.leaf.val;
+		return(0);
+	}
+	// The new key's hash matches the old leaf's hash so far. Make a
+	// single-twig branch for each further chunk that they share, then
+	// a two-twig branch where they differ.
+	Trie t2 = *t; // Save before overwriting.
+	Hcursor c2 = hleaf(&t2, c1.d1, c1.d2);
+	Trie *p = t;
+	for(;;) {
+		b1 = hbit(&c1);
+		uintptr_t b2 = hbit(&c2);
+		Trie *twigs = malloc(sizeof(Trie) * (b1 == b2 ? 1 : 2));
+		if(twigs == NULL) {
+			free_chain(t, p);
+			*t = t2;
+			return(-1);
+		}
+		p->branch.map = b1 | b2;
+		twigset(p, twigs);
+		if(b1 != b2) {
+			*twig(p, twigoff(p, b1)) = t1;
+			*twig(p, twigoff(p, b2)) = t2;
+			return(1);
+		}
+		p = twigs;
+		hnext(&c1);
+		hnext(&c2);
+	}
+growbranch:
+	assert(!hastwig(t, b1));
+	uint s = twigoff(t, b1), m = twigmax(t);
+	Trie *twigs = malloc(sizeof(Trie) * (m + 1));
+	if(twigs == NULL) return(-1);
+	memcpy(twigs, twig(t, 0), sizeof(Trie) * s);
+	memcpy(twigs+s, &t1, sizeof(Trie));
+	memcpy(twigs+s+1, twig(t, s), sizeof(Trie) * (m - s));
+	free(twig(t, 0));
+	twigset(t, twigs);
+	t->branch.map |= b1;
+	return(1);
+}
+
+#ifdef HAVE_ROOT_ARRAY
+
+// Move the leaves of the trie t into lo or hi, depending on the given
+// bit of their root index. Returns false if allocation fails.
+
+static bool
+split_rec(Trie *t, Trie *lo, Trie *hi, uint bit) {
+	if(isbranch(t)) {
+		uint m = twigmax(t);
+		for(uint i = 0; i < m; i++)
+			if(!split_rec(twig(t, i), lo, hi, bit))
+				return(false);
+		return(true);
+	}
+	Hcursor c = hleaf(t, 0, 0);
+	Trie *r = (c.h >> (Hbits - Rbits) >> bit) & 1 ? hi : lo;
+	if(isempty(r)) {
+		*r = *t;
+		return(true);
+	}
+	return(insert(r, *t, c, c.h) >= 0);
+}
+
+// Split the next slot in this round of linear hashing. If allocation
+// fails the table stays as it is, which is still correct.
+
+static void
+split(Tbl *tbl) {
+	if(tbl->level == Rbits)
+		return;
+	size_t n = (size_t)1 << tbl->level;
+	if(tbl->split == 0) {
+		Trie *slot = realloc(tbl->slot, sizeof(Trie) * n * 2);
+		if(slot == NULL) return;
+		tbl->slot = slot;
+	}
+	Trie *t = &tbl->slot[tbl->split], lo, hi;
+	memset(&lo, 0, sizeof(lo));
+	memset(&hi, 0, sizeof(hi));
+	if(!isempty(t) && !split_rec(t, &lo, &hi, tbl->level)) {
+		free_rec(&lo);
+		free_rec(&hi);
+		return;
+	}
+	free_rec(t);
+	*t = lo;
+	tbl->slot[n + tbl->split] = hi;
+	if(++tbl->split == n) {
+		tbl->level += 1;
+		tbl->split = 0;
+	}
+}
+
+#endif
+
+// Count a new key, and grow the root array if it is getting full.
+
+static inline Tbl *
+added(Tbl *tbl) {
+#ifdef HAVE_ROOT_ARRAY
+	tbl->count += 1;
+	if(tbl->count > roots(tbl) * Rload)
+		split(tbl);
+#endif
 	return(tbl);
 }
 
@@ -146,55 +499,33 @@ Tsetl(Tbl *tbl, const char *key, size_t len, void *val) {
 	}
 	if(val == NULL)
 		return(Tdell(tbl, key, len));
+	Hcursor c1 = hcursor(key, len, 0, 0);
+	uint64_t h = c1.h;
+	Trie t1;
+	leafset(&t1, key, len, val, h);
 	// First leaf in an empty tbl?
 	if(tbl == NULL) {
+#ifdef HAVE_ROOT_ARRAY
+		tbl = calloc(1, sizeof(*tbl));
+		if(tbl == NULL) return(NULL);
+		tbl->slot = calloc(1, sizeof(Trie));
+		if(tbl->slot == NULL) {
+			free(tbl);
+			return(NULL);
+		}
+#else
 		tbl = malloc(sizeof(*tbl));
 		if(tbl == NULL) return(NULL);
-		tbl->root.leaf.key = key;
-		tbl->root.leaf.val = val;
+		tbl->root = t1;
 		return(tbl);
+#endif
 	}
-	Trie *t = &tbl->root;
-	Trie t1 = { .leaf = { .key = key, .val = val } };
-	uint d1, d2;
-	uintptr_t b1;
-	for(d1 = 0 ;; ++d1) {
-		uint64_t h = hash(key, len, d1);
-		for(d2 = lglgN; d2 < Hbits; d2 += lglgN, h >>= lglgN) {
-			b1 = twigbit(h);
-			if(!isbranch(t))
-				goto leaf;
-			if(!hastwig(t, b1))
-				goto growbranch;
-			t = twig(t, twigoff(t, b1));
-		}
+	Trie *t = root(tbl, rootindex(tbl, h));
+	if(isempty(t)) {
+		*t = t1;
+		return(added(tbl));
 	}
-leaf:	if(strcmp(key, t->leaf.key) != 0)
-		goto newbranch;
-	t->leaf.val = val;
-	return(tbl);
-newbranch:;
-	// XXX May need multiple levels of trie here.
-	Trie *twigs = malloc(sizeof(Trie) * 2);
-	if(twigs == NULL) return(NULL);
-	Trie t2 = *t; // Save before overwriting.
-	uint64_t h2 = hash(t->leaf.key, strlen(t->leaf.key), d1);
-	uint64_t b2 = twigbit(h2 >>= d2 - lglgN);
-	t->branch.map = b1 | b2;
-	twigset(t, twigs);
-	*twig(t, twigoff(t, b1)) = t1;
-	*twig(t, twigoff(t, b2)) = t2;
-	return(tbl);
-growbranch:;
-	assert(!hastwig(t, b1));
-	uint s = twigoff(t, b1), m = twigmax(t);
-	twigs = malloc(sizeof(Trie) * (m + 1));
-	if(twigs == NULL) return(NULL);
-	memcpy(twigs, twig(t, 0), sizeof(Trie) * s);
-	memcpy(twigs+s, &t1, sizeof(Trie));
-	memcpy(twigs+s+1, twig(t, s), sizeof(Trie) * (m - s));
-	free(twig(t, 0));
-	twigset(t, twigs);
-	t->branch.map |= b1;
-	return(tbl);
+	int r = insert(t, t1, c1, h);
+	if(r < 0) return(NULL);
+	return(r > 0 ? added(tbl) : tbl);
 }
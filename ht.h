@@ -4,6 +4,48 @@
 // You may do anything with this. It has no warranty.
 // <http://creativecommons.org/publicdomain/zero/1.0/>
 
+// A HAMT is a trie keyed on the hash of the key, whose branches are
+// popcount-compressed arrays of twigs, like a qp trie. A branch is
+// indexed by the next lglgN bits of the hash. When two keys share more
+// hash bits, they are separated by a chain of single-twig branches, and
+// when the 64 bits of a SipHash value are used up the keys are hashed
+// again with a different SipHash key, so collisions of any depth are
+// handled. Deleting a key unsplices any chain of single-twig branches
+// that is left above a lone leaf, so a leaf is never below a
+// single-twig branch.
+//
+// The first hash of a key is HASH() from hash.h, which can be chosen
+// at compile time. Rehashing always uses SipHash-2-4, keyed with the
+// depth, because a weak hash might not separate keys however it is
+// seeded: two keys with the same CRC32C and length collide for any
+// initial CRC value.
+//
+// The keys are in hash order, so Tnextl() does not return them sorted.
+//
+// With HAVE_HASH_CACHE, each leaf keeps its key's first hash value,
+// so that splitting a leaf does not hash its key again, and a lookup
+// can usually reject the wrong leaf without comparing keys. This makes
+// every twig three words instead of two. The makefile builds this as
+// the hh variant.
+//
+// With HAVE_ROOT_ARRAY, the top of the table is a hash table of HAMTs
+// instead of a single HAMT, indexed by the top Rbits of each key's
+// first hash, so that a lookup skips the top levels of a large trie.
+// The array grows by linear hashing: when the table has more than
+// Rload keys per slot, the next slot in the round is split in two by
+// moving the keys that have the next bit of the index set into a new
+// slot at the end, so each insert does a bounded amount of work. An
+// empty slot is a leaf with a NULL key. The array does not shrink. The
+// makefile builds this as the hr variant.
+//
+// With HAVE_BINARY_KEYS, keys may contain '\0' bytes, so each leaf
+// keeps its key's length, which is compared before the keys are
+// compared with memcmp(). The makefile builds this as the hl variant.
+//
+// For testing, HASH_MASK can be defined to throw away most of the
+// bits of each hash value, so that long collision chains and rehashes
+// are common. The makefile builds this as the hc variant.
+
 typedef unsigned char byte;
 typedef unsigned int uint;
 
@@ -41,13 +83,19 @@ popcount(uintptr_t w) {
 
 #define Hbits 64
 
-extern int
-siphash(uint8_t *out, const uint8_t *in, uint64_t inlen, const uint8_t *k);
+// The number of keys that Tgetn() looks up at once.
+#define Hbatch 8
 
 
 typedef struct Tleaf {
 	const char *key;
 	void *val;
+#ifdef HAVE_BINARY_KEYS
+	size_t len;
+#endif
+#ifdef HAVE_HASH_CACHE
+	uint64_t hash;
+#endif
 } Tleaf;
 
 typedef struct Tbranch {
@@ -60,10 +108,25 @@ typedef union Trie {
 	struct Tbranch branch;
 } Trie;
 
+#ifdef HAVE_ROOT_ARRAY
+
+#define Rbits 24
+#define Rload 16
+
+struct Tbl {
+	size_t count, split;
+	uint level;
+	union Trie *slot;
+};
+
+#else
+
 struct Tbl {
 	union Trie root;
 };
 
+#endif
+
 static inline bool
 isbranch(Trie *t) {
 	return(t->branch.twigs & 1);
@@ -98,3 +161,108 @@ static inline void
 twigset(Trie *t, Trie *twigs) {
 	t->branch.twigs = (uintptr_t)twigs | 1;
 }
+
+// The hash is the key's first hash value. Without HAVE_HASH_CACHE it
+// is ignored.
+
+static inline void
+leafset(Trie *t, const char *key, size_t len, void *val, uint64_t hash) {
+	t->leaf.key = key;
+	t->leaf.val = val;
+#ifdef HAVE_BINARY_KEYS
+	t->leaf.len = len;
+#else
+	(void)len;
+#endif
+#ifdef HAVE_HASH_CACHE
+	t->leaf.hash = hash;
+#else
+	(void)hash;
+#endif
+}
+
+#ifdef HAVE_BINARY_KEYS
+
+static inline size_t
+leaflen(Trie *t) {
+	return(t->leaf.len);
+}
+
+static inline bool
+keymatch(Trie *t, const char *key, size_t len) {
+	return(len == t->leaf.len && memcmp(key, t->leaf.key, len) == 0);
+}
+
+#else
+
+static inline size_t
+leaflen(Trie *t) {
+	return(strlen(t->leaf.key));
+}
+
+static inline bool
+keymatch(Trie *t, const char *key, size_t len) {
+	(void)len;
+	return(strcmp(key, t->leaf.key) == 0);
+}
+
+#endif
+
+static inline bool
+leafmatch(Trie *t, const char *key, size_t len, uint64_t hash) {
+#ifdef HAVE_HASH_CACHE
+	if(t->leaf.hash != hash)
+		return(false);
+#else
+	(void)hash;
+#endif
+	return(keymatch(t, key, len));
+}
+
+// The roots of the tries in a table.
+
+static inline size_t
+roots(Tbl *tbl) {
+#ifdef HAVE_ROOT_ARRAY
+	return(((size_t)1 << tbl->level) + tbl->split);
+#else
+	(void)tbl;
+	return(1);
+#endif
+}
+
+static inline Trie *
+root(Tbl *tbl, size_t i) {
+#ifdef HAVE_ROOT_ARRAY
+	return(&tbl->slot[i]);
+#else
+	(void)i;
+	return(&tbl->root);
+#endif
+}
+
+// The index of the root for a key's first hash.
+
+static inline size_t
+rootindex(Tbl *tbl, uint64_t hash) {
+#ifdef HAVE_ROOT_ARRAY
+	size_t x = (size_t)(hash >> (Hbits - Rbits));
+	size_t i = x & (((size_t)1 << tbl->level) - 1);
+	if(i < tbl->split)
+		i = x & (((size_t)2 << tbl->level) - 1);
+	return(i);
+#else
+	(void)tbl; (void)hash;
+	return(0);
+#endif
+}
+
+static inline bool
+isempty(Trie *t) {
+#ifdef HAVE_ROOT_ARRAY
+	return(!isbranch(t) && t->leaf.key == NULL);
+#else
+	(void)t;
+	return(false);
+#endif
+}
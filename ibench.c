@@ -0,0 +1,161 @@
+// ibench.c: integer table benchmark.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/time.h>
+
+#include "Ibl.h"
+
+static const char *progname;
+
+static void
+die(const char *cause) {
+	fprintf(stderr, "%s: %s: %s\n", progname, cause, strerror(errno));
+	exit(1);
+}
+
+static void
+usage(void) {
+	fprintf(stderr,
+"usage: %s <seed> <count> <keys>\n"
+"	The seed must be at least 12 characters.\n"
+"	Each of the dense, sparse and clustered key distributions\n"
+"	is loaded with <keys> keys then searched and mutated <count>\n"
+"	times.\n"
+		, progname);
+	exit(1);
+}
+
+static struct timeval tu;
+
+static void
+start(const char *s) {
+	printf("%s... ", s);
+	gettimeofday(&tu, NULL);
+}
+
+static void
+done(void) {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	tv.tv_sec -= tu.tv_sec;
+	tv.tv_usec -= tu.tv_usec;
+	if(tv.tv_usec < 0) {
+		tv.tv_sec -= 1;
+		tv.tv_usec += 1000000;
+	}
+	printf("%ld.%06ld s\n", (long)tv.tv_sec, (long)tv.tv_usec);
+}
+
+static int
+ssrandom(char *s) {
+	// initialize random(3) from a string
+	size_t len = strlen(s);
+	if(len < 12) return(-1);
+	unsigned seed = s[0] | s[1] << 8 | s[2] << 16 | s[3] << 24;
+	initstate(seed, s+4, len-4);
+	return(0);
+}
+
+static uint64_t
+random64(void) {
+	// random() returns 31 bits
+	return((uint64_t)random() << 62 ^
+	       (uint64_t)random() << 31 ^
+	       (uint64_t)random());
+}
+
+// Sequential IDs starting from zero, in random order.
+static void
+dense(uint64_t *key, size_t n) {
+	for(size_t i = 0; i < n; i++)
+		key[i] = i;
+	for(size_t i = n - 1; i > 0; i--) {
+		size_t j = (size_t)random() % (i + 1);
+		uint64_t k = key[i]; key[i] = key[j]; key[j] = k;
+	}
+}
+
+// Uniformly random 64 bit IDs.
+static void
+sparse(uint64_t *key, size_t n) {
+	for(size_t i = 0; i < n; i++)
+		key[i] = random64();
+}
+
+// Runs of up to 256 sequential IDs at random places.
+static void
+clustered(uint64_t *key, size_t n) {
+	for(size_t i = 0; i < n; ) {
+		uint64_t base = random64();
+		size_t run = 1 + (size_t)random() % 256;
+		for(size_t j = 0; j < run && i < n; j++)
+			key[i++] = base + j;
+	}
+}
+
+static void
+bench(const char *name, void (*gen)(uint64_t *, size_t),
+    uint64_t *key, size_t n, int N) {
+	gen(key, n);
+	printf("- %s %zu keys\n", name, n);
+
+	start("load");
+	Ibl *t = NULL;
+	for(size_t l = 0; l < n; l++)
+		t = Iset(t, key[l], bench);
+	done();
+
+	start("search");
+	int found = 0;
+	for(int i = 0; i < N; i++)
+		if(Iget(t, key[(size_t)random() % n]) != NULL)
+			++found;
+	assert(found == N);
+	done();
+
+	start("mutate");
+	for(int i = 0; i < N; i++)
+		t = Iset(t, key[(size_t)random() % n],
+			 random() % 2 ? bench : NULL);
+	done();
+
+	// ensure all keys present
+	for(size_t l = 0; l < n; l++)
+		t = Iset(t, key[l], bench);
+	start("free");
+	for(size_t l = 0; l < n; l++)
+		t = Iset(t, key[l], NULL);
+	assert(t == NULL);
+	done();
+}
+
+int
+main(int argc, char *argv[]) {
+	progname = argv[0];
+	if(argc != 4 || argv[1][0] == '-') usage();
+	if(ssrandom(argv[1]) < 0) usage();
+	int N = atoi(argv[2]);
+	size_t n = (size_t)atol(argv[3]);
+	if(N < 0 || n == 0) usage();
+
+	uint64_t *key = calloc(n, sizeof(*key));
+	if(key == NULL) die("calloc");
+
+	bench("dense", dense, key, n, N);
+	bench("sparse", sparse, key, n, N);
+	bench("clustered", clustered, key, n, N);
+
+	free(key);
+	return(0);
+}
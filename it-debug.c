@@ -0,0 +1,74 @@
+// it-debug.c: it trie debug support
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Ibl.h"
+#include "it.h"
+
+static void
+dump_rec(Trie *t, int d) {
+	if(isbranch(t)) {
+		printf("Idump%*s branch %p %08x %u\n", d, "", t,
+		    t->branch.bitmap, t->branch.shift);
+		int dd = 2 + (60 - t->branch.shift) / 5 * 2;
+		assert(dd > d);
+		for(uint i = 0; i < 32; i++) {
+			Tbitmap b = 1U << i;
+			if(hastwig(t, b)) {
+				printf("Idump%*s twig %d\n", d, "", i);
+				dump_rec(twig(t, twigoff(t, b)), dd);
+			}
+		}
+	} else {
+		printf("Idump%*s leaf %p\n", d, "", t);
+		printf("Idump%*s leaf key %016llx\n", d, "",
+		       (unsigned long long)t->leaf.key);
+		printf("Idump%*s leaf val %p\n", d, "",
+		       t->leaf.val);
+	}
+}
+
+void
+Idump(Ibl *tbl) {
+	printf("Idump root %p\n", tbl);
+	if(tbl != NULL)
+		dump_rec(&tbl->root, 0);
+}
+
+static void
+size_rec(Trie *t, uint d,
+    size_t *rsize, size_t *rdepth, size_t *rbranches, size_t *rleaves) {
+	*rsize += sizeof(*t);
+	if(isbranch(t)) {
+		*rbranches += 1;
+		// Count unused capacity in the twig array as overhead.
+		uint m = popcount(t->branch.bitmap);
+		*rsize += sizeof(*t) * (twigcap(m) - m);
+		for(uint i = 0; i < 32; i++) {
+			Tbitmap b = 1U << i;
+			if(hastwig(t, b))
+				size_rec(twig(t, twigoff(t, b)),
+				    d+1, rsize, rdepth, rbranches, rleaves);
+		}
+	} else {
+		*rleaves += 1;
+		*rdepth += d;
+	}
+}
+
+void
+Isize(Ibl *tbl, const char **rtype,
+    size_t *rsize, size_t *rdepth, size_t *rbranches, size_t *rleaves) {
+	*rtype = "it";
+	*rsize = *rdepth = *rbranches = *rleaves = 0;
+	if(tbl != NULL)
+		size_rec(&tbl->root, 0, rsize, rdepth, rbranches, rleaves);
+}
@@ -0,0 +1,232 @@
+// it.c: integer tables implemented with fivebit popcount patricia tries.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Ibl.h"
+#include "it.h"
+
+bool
+Igetkv(Ibl *tbl, uint64_t key, void **pval) {
+	if(tbl == NULL)
+		return(false);
+	Trie *t = &tbl->root;
+	while(isbranch(t)) {
+		__builtin_prefetch(t->branch.twigs);
+		Tbitmap b = twigbit(t, key);
+		if(!hastwig(t, b))
+			return(false);
+		t = twig(t, twigoff(t, b));
+	}
+	if(key != t->leaf.key)
+		return(false);
+	*pval = t->leaf.val;
+	return(true);
+}
+
+void *
+Iget(Ibl *tbl, uint64_t key) {
+	void *val = NULL;
+	if(Igetkv(tbl, key, &val))
+		return(val);
+	else
+		return(NULL);
+}
+
+bool
+Inext(Ibl *tbl, uint64_t *pkey, void **pval) {
+	if(tbl == NULL)
+		return(false);
+	uint64_t key = *pkey;
+	// Find the most similar leaf, as in Iset().
+	Trie *t = &tbl->root;
+	while(isbranch(t)) {
+		Tbitmap b = twigbit(t, key);
+		uint i = hastwig(t, b) ? twigoff(t, b) : 0;
+		t = twig(t, i);
+	}
+	uint64_t diff = key ^ t->leaf.key;
+	if(diff == 0)
+		goto found;
+	// Walk down to where our key leaves the trie, remembering the
+	// path so that we can back up to a following twig. There can be
+	// at most one branch per chunk above that point.
+	bool greater = t->leaf.key > key;
+	uint shift = keyshift(diff);
+	Trie *path[13];
+	uint off[13], d = 0;
+	t = &tbl->root;
+	while(isbranch(t) && t->branch.shift > shift) {
+		Tbitmap b = twigbit(t, key);
+		assert(hastwig(t, b));
+		path[d] = t;
+		off[d] = twigoff(t, b);
+		t = twig(t, off[d++]);
+	}
+	if(isbranch(t) && t->branch.shift == shift) {
+		// Our key is missing from this branch, and the twigs
+		// after its position have greater keys.
+		Tbitmap b = twigbit(t, key);
+		uint s, m; TWIGOFFMAX(s, m, t, b);
+		if(s < m) {
+			t = twig(t, s);
+			goto first;
+		}
+	} else if(greater) {
+		// Every key under t has the same prefix as the leaf.
+		goto first;
+	}
+	while(d > 0) {
+		t = path[--d];
+		if(off[d] + 1 < popcount(t->branch.bitmap)) {
+			t = twig(t, off[d] + 1);
+			goto first;
+		}
+	}
+	return(false);
+first:
+	while(isbranch(t))
+		t = twig(t, 0);
+found:
+	*pkey = t->leaf.key;
+	*pval = t->leaf.val;
+	return(true);
+}
+
+Ibl *
+Idelkv(Ibl *tbl, uint64_t key, void **pval) {
+	if(tbl == NULL)
+		return(NULL);
+	Trie *t = &tbl->root, *p = NULL;
+	Tbitmap b = 0;
+	while(isbranch(t)) {
+		__builtin_prefetch(t->branch.twigs);
+		b = twigbit(t, key);
+		if(!hastwig(t, b))
+			return(tbl);
+		p = t; t = twig(t, twigoff(t, b));
+	}
+	if(key != t->leaf.key)
+		return(tbl);
+	*pval = t->leaf.val;
+	if(p == NULL) {
+		free(tbl);
+		return(NULL);
+	}
+	t = p; p = NULL; // Becuase t is the usual name
+	uint s, m; TWIGOFFMAX(s, m, t, b);
+	if(m == 2) {
+		// Move the other twig to the parent branch.
+		Trie *twigs = t->branch.twigs;
+		*t = *twig(t, !s);
+		free(twigs);
+		return(tbl);
+	}
+	memmove(t->branch.twigs+s, t->branch.twigs+s+1, sizeof(Trie) * (m - s - 1));
+	t->branch.bitmap &= ~b;
+	// We have now correctly removed the twig from the trie, so if
+	// realloc() fails we can ignore it and continue to use the
+	// slightly oversized twig array.
+	if(twigcap(m - 1) < twigcap(m)) {
+		Trie *twigs = realloc(t->branch.twigs,
+		    sizeof(Trie) * twigcap(m - 1));
+		if(twigs != NULL) t->branch.twigs = twigs;
+	}
+	return(tbl);
+}
+
+Ibl *
+Idel(Ibl *tbl, uint64_t key) {
+	void *val = NULL;
+	return(Idelkv(tbl, key, &val));
+}
+
+Ibl *
+Iset(Ibl *tbl, uint64_t key, void *val) {
+	// Ensure flag bits are zero.
+	if(((uint64_t)val & 1) != 0) {
+		errno = EINVAL;
+		return(NULL);
+	}
+	if(val == NULL)
+		return(Idel(tbl, key));
+	// First leaf in an empty tbl?
+	if(tbl == NULL) {
+		tbl = malloc(sizeof(*tbl));
+		if(tbl == NULL) return(NULL);
+		tbl->root.leaf.key = key;
+		tbl->root.leaf.val = val;
+		return(tbl);
+	}
+	Trie *t = &tbl->root;
+	// Find the most similar leaf node in the trie. We will compare
+	// its key with our new key to find the first differing chunk,
+	// which can be at a lower index than the point at which we
+	// detect a difference.
+	while(isbranch(t)) {
+		__builtin_prefetch(t->branch.twigs);
+		Tbitmap b = twigbit(t, key);
+		// Even if our key is missing from this branch we need to
+		// keep iterating down to a leaf. It doesn't matter which
+		// twig we choose since the keys are all the same up to this
+		// index. Note that blindly using twigoff(t, b) can cause
+		// an out-of-bounds index if it equals twigmax(t).
+		uint i = hastwig(t, b) ? twigoff(t, b) : 0;
+		t = twig(t, i);
+	}
+	// Do the keys differ, and if so, where?
+	uint64_t diff = key ^ t->leaf.key;
+	if(diff == 0) {
+		t->leaf.val = val;
+		return(tbl);
+	}
+	uint shift = keyshift(diff);
+	Tbitmap b1 = nibbit(key, shift);
+	Tbitmap b2 = nibbit(t->leaf.key, shift);
+	// Prepare the new leaf.
+	Trie t1 = { .leaf = { .key = key, .val = val } };
+	// Find where to insert a branch or grow an existing branch.
+	t = &tbl->root;
+	while(isbranch(t)) {
+		__builtin_prefetch(t->branch.twigs);
+		if(shift == t->branch.shift)
+			goto growbranch;
+		if(shift > t->branch.shift)
+			goto newbranch;
+		Tbitmap b = twigbit(t, key);
+		assert(hastwig(t, b));
+		t = twig(t, twigoff(t, b));
+	}
+newbranch:;
+	Trie *twigs = malloc(sizeof(Trie) * 2);
+	if(twigs == NULL) return(NULL);
+	Trie t2 = *t; // Save before overwriting.
+	t->branch.twigs = twigs;
+	t->branch.isbranch = 1;
+	t->branch.shift = shift;
+	t->branch.bitmap = b1 | b2;
+	*twig(t, twigoff(t, b1)) = t1;
+	*twig(t, twigoff(t, b2)) = t2;
+	return(tbl);
+growbranch:;
+	assert(!hastwig(t, b1));
+	uint s, m; TWIGOFFMAX(s, m, t, b1);
+	twigs = t->branch.twigs;
+	if(twigcap(m + 1) > twigcap(m)) {
+		twigs = realloc(twigs, sizeof(Trie) * twigcap(m + 1));
+		if(twigs == NULL) return(NULL);
+	}
+	memmove(twigs+s+1, twigs+s, sizeof(Trie) * (m - s));
+	memmove(twigs+s, &t1, sizeof(Trie));
+	t->branch.twigs = twigs;
+	t->branch.bitmap |= b1;
+	return(tbl);
+}
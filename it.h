@@ -0,0 +1,130 @@
+// it.h: integer tables implemented with fivebit popcount patricia tries.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+// See qp.h for introductory comments about tries, and fp.h for the
+// fivebit variant.
+//
+// The it trie is a clone-and-hack of the fp trie specialized for 64
+// bit integer keys (see Ibl.h). The key is stored in the leaf instead
+// of a pointer to a key string, so checking a leaf does not need to
+// touch any more memory, and every key has the same length so there
+// is no need to handle the end of the key.
+//
+// The key is split into a 4 bit chunk at the top followed by twelve 5
+// bit chunks. A branch records the shift that brings its chunk to the
+// bottom of the word, so the shift of the first chunk is 60, then 55,
+// 50, ... down to 0. The 4 bit chunk just uses half of the bitmap.
+// Shifts decrease as we go down the trie, and any bit position b is in
+// the chunk whose shift is b / 5 * 5.
+
+typedef unsigned char byte;
+typedef unsigned int uint;
+
+typedef uint32_t Tbitmap;
+
+#if defined(HAVE_SLOW_POPCOUNT)
+
+static inline uint
+popcount(Tbitmap w) {
+	w -= (w >> 1) & 0x55555555;
+	w = (w & 0x33333333) + ((w >> 2) & 0x33333333);
+	w = (w + (w >> 4)) & 0x0F0F0F0F;
+	w = (w * 0x01010101) >> 24;
+	return(w);
+}
+
+#else
+
+static inline uint
+popcount(Tbitmap w) {
+	return((uint)__builtin_popcount(w));
+}
+
+#endif
+
+typedef struct Tleaf {
+	uint64_t key;
+	void *val;
+} Tleaf;
+
+// The isbranch flag overlaps the bottom bit of the leaf's value, so
+// values must be word-aligned as in qp and fp.
+
+typedef struct Tbranch {
+	union Trie *twigs;
+	uint32_t isbranch : 1,
+	         shift : 31;
+	Tbitmap bitmap;
+} Tbranch;
+
+typedef union Trie {
+	struct Tleaf   leaf;
+	struct Tbranch branch;
+} Trie;
+
+struct Ibl {
+	union Trie root;
+};
+
+static inline bool
+isbranch(Trie *t) {
+	return(t->branch.isbranch);
+}
+
+// The shift of the chunk containing the most significant bit where
+// two keys differ.
+
+static inline uint
+keyshift(uint64_t diff) {
+	return((uint)(63 - __builtin_clzll(diff)) / 5 * 5);
+}
+
+static inline Tbitmap
+nibbit(uint64_t key, uint shift) {
+	return(1U << ((key >> shift) & 0x1FU));
+}
+
+static inline Tbitmap
+twigbit(Trie *t, uint64_t key) {
+	return(nibbit(key, t->branch.shift));
+}
+
+static inline bool
+hastwig(Trie *t, Tbitmap bit) {
+	return(t->branch.bitmap & bit);
+}
+
+static inline uint
+twigoff(Trie *t, Tbitmap b) {
+	return(popcount(t->branch.bitmap & (b-1)));
+}
+
+static inline Trie *
+twig(Trie *t, uint i) {
+	return(&t->branch.twigs[i]);
+}
+
+#define TWIGOFFMAX(off, max, t, b) do {			\
+		off = twigoff(t, b);			\
+		max = popcount(t->branch.bitmap);	\
+	} while(0)
+
+// See qp.h for a description of the TWIG_SLACK size classes.
+
+#ifndef TWIG_SLACK
+#define TWIG_SLACK 0
+#endif
+
+static inline uint
+twigcap(uint m) {
+#if TWIG_SLACK == 2
+	return(m <= 2 ? 2 : 1U << (32 - __builtin_clz(m - 1)));
+#elif TWIG_SLACK == 1
+	return((m + 1) & ~1U);
+#else
+	return(m);
+#endif
+}
@@ -0,0 +1,121 @@
+// itest.c: test integer table implementations.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#define _WITH_GETLINE
+
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Ibl.h"
+
+static const char *progname;
+
+static void
+die(const char *cause) {
+	fprintf(stderr, "%s: %s: %s\n", progname, cause, strerror(errno));
+	exit(1);
+}
+
+static __attribute__((noreturn)) void
+usage(void) {
+	fprintf(stderr,
+"usage: %s [input]\n"
+"	The input is in the same format as for test.c, where each key\n"
+"	is a 16 digit hexadecimal number. Zero-padded hex sorts the same\n"
+"	as the numbers, so the output can be compared with test.pl.\n"
+	    , progname);
+	exit(1);
+}
+
+int
+main(int argc, char *argv[]) {
+	progname = argv[0];
+	if(argc > 2)
+		usage();
+	if(argc == 2) {
+		if(argv[1][0] == '-')
+			usage();
+		if(freopen(argv[1], "r", stdin) == NULL)
+			die("open");
+	}
+	Ibl *t = NULL;
+	char *line = NULL;
+	size_t size = 0;
+	for (;;) {
+		int s = getchar();
+		if(s < 0) break;
+		if(getline(&line, &size, stdin) < 0) break;
+		char *end = NULL;
+		uint64_t key = strtoull(line, &end, 16);
+		if(end != line + 16)
+			usage();
+		switch(s) {
+		default:
+			usage();
+		case('*'):
+			if(Iget(t, key))
+				putchar('*');
+			else
+				putchar('=');
+			continue;
+		case('+'):
+			errno = 0;
+			void *val = Iget(t, key);
+			if(val == NULL) {
+				uint64_t *kp = malloc(sizeof(*kp));
+				if(kp == NULL)
+					die("malloc");
+				*kp = key;
+				val = kp;
+			}
+			t = Iset(t, key, val);
+			if(t == NULL)
+				die("Ibl");
+			continue;
+		case('-'):
+			errno = 0;
+			void *rval = NULL;
+			t = Idelkv(t, key, &rval);
+			if(t == NULL && errno != 0)
+				die("Ibl");
+			free(rval);
+			continue;
+		}
+	}
+	free(line);
+	putchar('\n');
+	if(ferror(stdin))
+		die("read");
+	size_t depth, branches, leaves;
+	const char *type;
+	Isize(t, &type, &size, &depth, &branches, &leaves);
+	// Overhead is measured relative to a two-word key+value leaf.
+	double overhead = (double)(size / sizeof(void*)) - 2.0 * leaves;
+	fprintf(stderr, "SIZE %s leaves=%zu branches=%zu overhead=%.2f depth=%.2f\n",
+		type, leaves, branches,
+		overhead / leaves,
+		(double)depth / leaves);
+	// Inext() does not need the key to be present, so we can delete
+	// each item before moving on to the next.
+	uint64_t key = 0;
+	void *val = NULL;
+	while(Inext(t, &key, &val)) {
+		assert(*(uint64_t *)val == key);
+		printf("%016llx\n", (unsigned long long)key);
+		t = Idel(t, key);
+		free(val);
+		if(key == UINT64_MAX)
+			break;
+		key += 1;
+	}
+	assert(t == NULL);
+	return(0);
+}
@@ -0,0 +1,222 @@
+// qk.c: string sets implemented with qp tries and single-word leaves.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Tbl.h"
+#include "qk.h"
+
+// There is no __builtin_prefetch() in the loops below, because a
+// branch's header and twigs are in the same cache line, and we need
+// the header before we can choose a twig.
+
+bool
+Tgetkv(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
+	if(tbl == NULL)
+		return(false);
+	Trie *t = &tbl->root;
+	while(isbranch(t)) {
+		Tbitmap b = twigbit(t, key, len);
+		if(!hastwig(t, b))
+			return(false);
+		t = twig(t, twigoff(t, b));
+	}
+	if(strcmp(key, t->key) != 0)
+		return(false);
+	*pkey = t->key;
+	*pval = (void *)t->key;
+	return(true);
+}
+
+static bool
+next_rec(Trie *t, const char **pkey, size_t *plen, void **pval) {
+	if(isbranch(t)) {
+		// Recurse to find either this leaf (*pkey != NULL)
+		// or the next one (*pkey == NULL).
+		Tbitmap b = twigbit(t, *pkey, *plen);
+		uint s, m; TWIGOFFMAX(s, m, t, b);
+		for(; s < m; s++)
+			if(next_rec(twig(t, s), pkey, plen, pval))
+				return(true);
+		return(false);
+	}
+	// We have found the next leaf.
+	if(*pkey == NULL) {
+		*pkey = t->key;
+		*plen = strlen(*pkey);
+		*pval = (void *)t->key;
+		return(true);
+	}
+	// We have found this leaf, so start looking for the next one.
+	if(strcmp(*pkey, t->key) == 0) {
+		*pkey = NULL;
+		*plen = 0;
+		return(false);
+	}
+	// No match.
+	return(false);
+}
+
+bool
+Tnextl(Tbl *tbl, const char **pkey, size_t *plen, void **pval) {
+	if(tbl == NULL) {
+		*pkey = NULL;
+		*plen = 0;
+		return(NULL);
+	}
+	return(next_rec(&tbl->root, pkey, plen, pval));
+}
+
+static void
+free_rec(Trie *t) {
+	if(!isbranch(t))
+		return;
+	uint m = popcount(branch(t)->bitmap);
+	for(uint i = 0; i < m; i++)
+		free_rec(twig(t, i));
+	free(branch(t));
+}
+
+void
+Tfree(Tbl *tbl) {
+	if(tbl == NULL)
+		return;
+	free_rec(&tbl->root);
+	free(tbl);
+}
+
+Tbl *
+Tdelkv(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
+	if(tbl == NULL)
+		return(NULL);
+	Trie *t = &tbl->root, *p = NULL;
+	Tbitmap b = 0;
+	while(isbranch(t)) {
+		b = twigbit(t, key, len);
+		if(!hastwig(t, b))
+			return(tbl);
+		p = t; t = twig(t, twigoff(t, b));
+	}
+	if(strcmp(key, t->key) != 0)
+		return(tbl);
+	*pkey = t->key;
+	*pval = (void *)t->key;
+	if(p == NULL) {
+		free(tbl);
+		return(NULL);
+	}
+	t = p; p = NULL; // Becuase t is the usual name
+	uint s, m; TWIGOFFMAX(s, m, t, b);
+	Tbranch *br = branch(t);
+	if(m == 2) {
+		// Move the other twig to the parent branch.
+		*t = br->twigs[!s];
+		free(br);
+		return(tbl);
+	}
+	memmove(br->twigs+s, br->twigs+s+1, sizeof(Trie) * (m - s - 1));
+	br->bitmap &= ~b;
+	// We have now correctly removed the twig from the trie, so if
+	// realloc() fails we can ignore it and continue to use the
+	// slightly oversized branch.
+	if(twigcap(m - 1) < twigcap(m)) {
+		br = realloc(br, branchsize(m - 1));
+		if(br != NULL) branchset(t, br);
+	}
+	return(tbl);
+}
+
+Tbl *
+Tsetl(Tbl *tbl, const char *key, size_t len, void *val) {
+	// Ensure the tag bit is zero.
+	if(((uint64_t)key & BRANCH_TAG) != 0) {
+		errno = EINVAL;
+		return(NULL);
+	}
+	if(val == NULL)
+		return(Tdell(tbl, key, len));
+	// First leaf in an empty tbl?
+	if(tbl == NULL) {
+		tbl = malloc(sizeof(*tbl));
+		if(tbl == NULL) return(NULL);
+		tbl->root.key = key;
+		return(tbl);
+	}
+	Trie *t = &tbl->root;
+	// Find the most similar leaf node in the trie. We will compare
+	// its key with our new key to find the first differing nibble,
+	// which can be at a lower index than the point at which we
+	// detect a difference.
+	while(isbranch(t)) {
+		Tbitmap b = twigbit(t, key, len);
+		// Even if our key is missing from this branch we need to
+		// keep iterating down to a leaf. It doesn't matter which
+		// twig we choose since the keys are all the same up to this
+		// index. Note that blindly using twigoff(t, b) can cause
+		// an out-of-bounds index if it equals twigmax(t).
+		uint i = hastwig(t, b) ? twigoff(t, b) : 0;
+		t = twig(t, i);
+	}
+	// Do the keys differ, and if so, where?
+	size_t i;
+	for(i = 0; i <= len; i++) {
+		if(key[i] != t->key[i])
+			goto newkey;
+	}
+	// Already a member of the set.
+	return(tbl);
+newkey:; // We have the branch's index; what are its flags?
+	byte k1 = (byte)key[i], k2 = (byte)t->key[i];
+	uint f =  k1 ^ k2;
+	f = (f & 0xf0) ? 1 : 2;
+	// Prepare the new leaf.
+	Tbitmap b1 = nibbit(k1, f);
+	Trie t1 = { .key = key };
+	// Find where to insert a branch or grow an existing branch.
+	t = &tbl->root;
+	while(isbranch(t)) {
+		Tbranch *br = branch(t);
+		if(i == br->index && f == br->flags)
+			goto growbranch;
+		if(i == br->index && f < br->flags)
+			goto newbranch;
+		if(i < br->index)
+			goto newbranch;
+		Tbitmap b = twigbit(t, key, len);
+		assert(hastwig(t, b));
+		t = twig(t, twigoff(t, b));
+	}
+newbranch:;
+	Tbranch *br = malloc(branchsize(2));
+	if(br == NULL) return(NULL);
+	Trie t2 = *t; // Save before overwriting.
+	Tbitmap b2 = nibbit(k2, f);
+	br->flags = f;
+	br->index = i;
+	br->bitmap = b1 | b2;
+	branchset(t, br);
+	*twig(t, twigoff(t, b1)) = t1;
+	*twig(t, twigoff(t, b2)) = t2;
+	return(tbl);
+growbranch:;
+	assert(!hastwig(t, b1));
+	uint s, m; TWIGOFFMAX(s, m, t, b1);
+	br = branch(t);
+	if(twigcap(m + 1) > twigcap(m)) {
+		br = realloc(br, branchsize(m + 1));
+		if(br == NULL) return(NULL);
+		branchset(t, br);
+	}
+	memmove(br->twigs+s+1, br->twigs+s, sizeof(Trie) * (m - s));
+	memmove(br->twigs+s, &t1, sizeof(Trie));
+	br->bitmap |= b1;
+	return(tbl);
+}
@@ -0,0 +1,159 @@
+// qk.h: string sets implemented with qp tries and single-word leaves.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+// See qp.h for introductory comments about tries.
+//
+// A qp trie leaf holds a key and a value, and branches are the same
+// size as leaves so that twig arrays pack neatly. When the table is
+// used as a set of strings the value word in every leaf is wasted.
+//
+// The qk trie is a set-only clone-and-hack of the qp trie which uses
+// a layout like DJB's crit-bit trees (see cb.h). Each element of a
+// twig array is a single word: either a pointer to a leaf's key
+// string, or a tagged pointer to a branch. The branch's flags, index
+// and bitmap are packed into a header word at the start of its twig
+// array, so they share a cache line with the twigs.
+//
+// [ ptr B ] -> [ flags index bitmap ]
+//              [ ptr L ] -> "leaf 0"
+//              [ ptr B ] --+
+//                          |
+//                          +-> [ flags index bitmap ]
+//                              [ ptr L ] -> "leaf 1"
+//                              [ ptr L ] -> "leaf 2"
+//
+// A leaf is one word and a branch with m twigs is one word in its
+// parent plus m+1 words of its own, compared to two words for every
+// leaf and branch in a qp trie.
+//
+// Key strings can be byte-aligned so the tag cannot go in the bottom
+// bits of the pointer. Instead it is the top bit, which is zero for
+// user-space addresses on current 64 bit systems (the same assumption
+// as HAVE_RAW_VALUES in qp.h).
+//
+// The Tbl.h value is only used as a presence flag: setting a key to a
+// non-NULL value adds it to the set, and lookups return the table's
+// key pointer as the value.
+
+typedef unsigned char byte;
+typedef unsigned int uint;
+
+typedef uint Tbitmap;
+
+#if defined(HAVE_SLOW_POPCOUNT)
+
+// NOTE: 16 bits only
+
+static inline uint
+popcount(Tbitmap w) {
+	w -= (w >> 1) & 0x5555;
+	w = (w & 0x3333) + ((w >> 2) & 0x3333);
+	w = (w + (w >> 4)) & 0x0F0F;
+	w = (w + (w >> 8)) & 0x00FF;
+	return(w);
+}
+
+#else
+
+static inline uint
+popcount(Tbitmap w) {
+	return((uint)__builtin_popcount(w));
+}
+
+#endif
+
+typedef union Trie {
+	const char *key;
+	uint64_t tagged;
+} Trie;
+
+// The flags, index and bitmap have the same meanings as in qp.h.
+
+typedef struct Tbranch {
+	uint64_t
+		flags : 2,
+		index : 46,
+		bitmap : 16;
+	union Trie twigs[];
+} Tbranch;
+
+struct Tbl {
+	union Trie root;
+};
+
+#define BRANCH_TAG ((uint64_t)1 << 63)
+
+static inline bool
+isbranch(Trie *t) {
+	return(t->tagged & BRANCH_TAG);
+}
+
+static inline Tbranch *
+branch(Trie *t) {
+	return((Tbranch *)(t->tagged ^ BRANCH_TAG));
+}
+
+static inline void
+branchset(Trie *t, Tbranch *b) {
+	t->tagged = (uint64_t)b | BRANCH_TAG;
+}
+
+static inline Tbitmap
+nibbit(byte k, uint flags) {
+	uint mask = ((flags - 2) ^ 0x0f) & 0xff;
+	uint shift = (2 - flags) << 2;
+	return(1 << ((k & mask) >> shift));
+}
+
+static inline Tbitmap
+twigbit(Trie *t, const char *key, size_t len) {
+	Tbranch *b = branch(t);
+	uint64_t i = b->index;
+	if(i >= len) return(1);
+	return(nibbit((byte)key[i], b->flags));
+}
+
+static inline bool
+hastwig(Trie *t, Tbitmap bit) {
+	return(branch(t)->bitmap & bit);
+}
+
+static inline uint
+twigoff(Trie *t, Tbitmap b) {
+	return(popcount(branch(t)->bitmap & (b-1)));
+}
+
+static inline Trie *
+twig(Trie *t, uint i) {
+	return(&branch(t)->twigs[i]);
+}
+
+#define TWIGOFFMAX(off, max, t, b) do {				\
+		off = twigoff(t, b);				\
+		max = popcount(branch(t)->bitmap);		\
+	} while(0)
+
+// See qp.h for a description of the TWIG_SLACK size classes.
+
+#ifndef TWIG_SLACK
+#define TWIG_SLACK 0
+#endif
+
+static inline uint
+twigcap(uint m) {
+#if TWIG_SLACK == 2
+	return(m <= 2 ? 2 : 1U << (32 - __builtin_clz(m - 1)));
+#elif TWIG_SLACK == 1
+	return((m + 1) & ~1U);
+#else
+	return(m);
+#endif
+}
+
+static inline size_t
+branchsize(uint m) {
+	return(sizeof(Tbranch) + sizeof(Trie) * twigcap(m));
+}
@@ -9,6 +9,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "Tbl.h"
 #include "qp.h"
@@ -20,7 +21,7 @@ dump_rec(Trie *t, int d) {
 		    (size_t)t->branch.index, t->branch.flags);
 		int dd = 2 + t->branch.index * 4 + (t->branch.flags - 1) * 2;
 		assert(dd > d);
-		for(uint i = 0; i < 16; i++) {
+		for(uint i = 0; i < Tbitmapbits; i++) {
 			uint b = 1 << i;
 			if(hastwig(t, b)) {
 				printf("Tdump%*s twig %d\n", d, "", i);
@@ -49,7 +50,10 @@ size_rec(Trie *t, uint d,
 	*rsize += sizeof(*t);
 	if(isbranch(t)) {
 		*rbranches += 1;
-		for(uint i = 0; i < 16; i++) {
+		// Count unused capacity in the twig array as overhead.
+		uint m = popcount(t->branch.bitmap);
+		*rsize += sizeof(*t) * (twigcap(m) - m);
+		for(uint i = 0; i < Tbitmapbits; i++) {
 			Tbitmap b = 1 << i;
 			if(hastwig(t, b))
 				size_rec(twig(t, twigoff(t, b)),
@@ -66,6 +70,13 @@ Tsize(Tbl *tbl, const char **rtype,
     size_t *rsize, size_t *rdepth, size_t *rbranches, size_t *rleaves) {
 	*rtype = "qp";
 	*rsize = *rdepth = *rbranches = *rleaves = 0;
-	if(tbl != NULL)
-		size_rec(&tbl->root, 0, rsize, rdepth, rbranches, rleaves);
+	if(tbl == NULL)
+		return;
+	size_rec(&tbl->root, 0, rsize, rdepth, rbranches, rleaves);
+#ifdef HAVE_OWNED_KEYS
+	// Count the arena as overhead, apart from the live keys.
+	*rsize += sizeof(*tbl) - sizeof(tbl->root) - tbl->live;
+	for(Tchunk *c = tbl->chunks; c != NULL; c = c->next)
+		*rsize += sizeof(*c) + c->size;
+#endif
 }
@@ -12,8 +12,10 @@
 #include <string.h>
 
 #include "Tbl.h"
+#include "Tdns.h"
 #include "qp.h"
 
+Tclones
 bool
 Tgetkv(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
 	if(tbl == NULL)
@@ -26,13 +28,14 @@ Tgetkv(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
 			return(false);
 		t = twig(t, twigoff(t, b));
 	}
-	if(strcmp(key, t->leaf.key) != 0)
+	if(!leafmatch(t, key, len))
 		return(false);
 	*pkey = t->leaf.key;
 	*pval = t->leaf.val;
 	return(true);
 }
 
+Tclones
 static bool
 next_rec(Trie *t, const char **pkey, size_t *plen, void **pval) {
 	if(isbranch(t)) {
@@ -48,12 +51,12 @@ next_rec(Trie *t, const char **pkey, size_t *plen, void **pval) {
 	// We have found the next leaf.
 	if(*pkey == NULL) {
 		*pkey = t->leaf.key;
-		*plen = strlen(*pkey);
+		*plen = leaflen(t);
 		*pval = t->leaf.val;
 		return(true);
 	}
 	// We have found this leaf, so start looking for the next one.
-	if(strcmp(*pkey, t->leaf.key) == 0) {
+	if(leafmatch(t, *pkey, *plen)) {
 		*pkey = NULL;
 		*plen = 0;
 		return(false);
@@ -72,6 +75,342 @@ Tnextl(Tbl *tbl, const char **pkey, size_t *plen, void **pval) {
 	return(next_rec(&tbl->root, pkey, plen, pval));
 }
 
+// Is the leaf's key the first len bytes of our key?
+
+static inline bool
+leafprefix(Trie *t, const char *key, size_t len) {
+	return(leaflen(t) == len && foldeq(key, t->leaf.key, len));
+}
+
+Tclones
+bool
+Tencloser(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
+	if(tbl == NULL)
+		return(false);
+	Trie *t = &tbl->root, *found = NULL;
+	size_t peeked = 0;
+	while(isbranch(t)) {
+		__builtin_prefetch(t->branch.twigs);
+		// If an ancestor that ends at this index is present, it is
+		// in the twig for the end of the key. If the branch is on
+		// the lower nibble, the upper nibble has already matched, so
+		// we only need to look once for each index. A deeper branch
+		// cannot contain the ancestor, because all of its keys would
+		// have to end at the same index.
+		size_t i = t->branch.index;
+		if(i < len && i >= peeked && (i == 0 || key[i-1] == Tdnssep)) {
+			Trie *u = t;
+			while(isbranch(u) && u->branch.index == i) {
+				Tbitmap b = twigbit(u, key, i);
+				if(!hastwig(u, b))
+					break;
+				u = twig(u, twigoff(u, b));
+			}
+			if(!isbranch(u) && leafprefix(u, key, i))
+				found = u;
+			peeked = i + 1;
+		}
+		Tbitmap b = twigbit(t, key, len);
+		if(!hastwig(t, b))
+			goto done;
+		t = twig(t, twigoff(t, b));
+	}
+	// The leaf we reached can be the key itself or an ancestor.
+	size_t tlen = leaflen(t);
+	if(tlen <= len && (tlen == len || tlen == 0 || key[tlen-1] == Tdnssep)
+	    && leafprefix(t, key, tlen))
+		found = t;
+done:
+	if(found == NULL)
+		return(false);
+	*pkey = found->leaf.key;
+	*pval = found->leaf.val;
+	return(true);
+}
+
+// The state of a predecessor search. When prev_rec() reaches a leaf,
+// it notes where the key first differs from the leaf's key, as in
+// Tsetl(), and the key's and the leaf's twig bits at that nibble.
+
+typedef struct Tprev {
+	size_t i;
+	uint f;
+	Tbitmap b1, b2;
+	Trie *found;
+} Tprev;
+
+// Does our key leave the trie above branch t?
+
+static inline bool
+prevabove(Trie *t, Tprev *p) {
+	return(p->i < t->branch.index ||
+	       (p->i == t->branch.index && p->f <= t->branch.flags));
+}
+
+// Descend towards the key as Tsetl() does, remembering the nearest
+// twig to the left of our path. The descent stops at a leaf, which
+// tells us where the key leaves the trie; then, as the recursion
+// unwinds, the frame for the point where the key leaves the trie
+// finds the predecessor. Returns true when p->found is set, and
+// p->found is NULL if the key has no predecessor.
+
+Tclones
+static bool
+prev_rec(Trie *t, Trie *parent, Trie *before,
+	 const char *key, size_t len, Tprev *p) {
+	if(isbranch(t)) {
+		__builtin_prefetch(t->branch.twigs);
+		Tbitmap b = twigbit(t, key, len);
+		Trie *left = before;
+		uint s = 0;
+		if(hastwig(t, b)) {
+			s = twigoff(t, b);
+			if(s > 0) left = twig(t, s - 1);
+		}
+		if(prev_rec(twig(t, s), t, left, key, len, p))
+			return(true);
+		// Keep unwinding until we are at the top branch that
+		// our key does not pass through.
+		if(!prevabove(t, p) || (parent != NULL && prevabove(parent, p)))
+			return(false);
+		if(p->i == t->branch.index && p->f == t->branch.flags) {
+			// Our key is missing from this branch, and the
+			// twigs before its position have smaller keys.
+			uint s1 = twigoff(t, p->b1);
+			if(s1 > 0) {
+				t = twig(t, s1 - 1);
+				goto last;
+			}
+		} else if(p->b2 < p->b1) {
+			// Every key under t has the same prefix as the leaf.
+			goto last;
+		}
+		goto before;
+	}
+	// Do the keys differ, and if so, where and which way?
+	const char *tkey = t->leaf.key;
+	size_t i;
+	uint f = 0;
+#ifdef HAVE_BINARY_KEYS
+	size_t tlen = t->leaf.len;
+	for(i = 0; i < len && i < tlen; i++) {
+		f = fold(key[i]) ^ fold(tkey[i]);
+		if(f != 0)
+			break;
+	}
+	if(f == 0 && len == tlen)
+		goto found;
+	f = (f == 0 || (f & 0xf0)) ? 1 : 2;
+	p->b1 = keybit(key, len, i, f);
+	p->b2 = keybit(tkey, tlen, i, f);
+#else
+	for(i = 0; fold(key[i]) == fold(tkey[i]); i++)
+		if(key[i] == '\0')
+			goto found;
+	f = (fold(key[i]) ^ fold(tkey[i])) & 0xf0 ? 1 : 2;
+	p->b1 = nibbit(fold(key[i]), f);
+	p->b2 = nibbit(fold(tkey[i]), f);
+#endif
+	p->i = i;
+	p->f = f;
+	// The leaf is where our key leaves the trie if its parent is not.
+	if(parent != NULL && prevabove(parent, p))
+		return(false);
+	if(p->b2 < p->b1)
+		goto found;
+before:
+	if(before == NULL) {
+		p->found = NULL;
+		return(true);
+	}
+	t = before;
+last:
+	while(isbranch(t))
+		t = twig(t, popcount(t->branch.bitmap) - 1);
+found:
+	p->found = t;
+	return(true);
+}
+
+Tclones
+bool
+Tprevl(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
+	if(tbl == NULL)
+		return(false);
+	Tprev p;
+	if(!prev_rec(&tbl->root, NULL, NULL, key, len, &p) || p.found == NULL)
+		return(false);
+	*pkey = p.found->leaf.key;
+	*pval = p.found->leaf.val;
+	return(true);
+}
+
+#ifdef HAVE_OWNED_KEYS
+
+// Chunk sizes double from Tchunkmin up to Tchunkmax, or more if a key
+// does not fit.
+
+#define Tchunkmin 4096
+#define Tchunkmax (1 << 20)
+
+static Tchunk *
+chunknew(Tchunk *next, size_t need) {
+	size_t size = next == NULL ? Tchunkmin : next->size * 2;
+	if(size > Tchunkmax) size = Tchunkmax;
+	if(size < need) size = need;
+	Tchunk *c = malloc(sizeof(*c) + size);
+	if(c == NULL) return(NULL);
+	c->next = next;
+	c->size = size;
+	c->used = 0;
+	return(c);
+}
+
+static const char *
+chunkcopy(Tchunk *c, const char *key, size_t len) {
+	char *copy = c->data + c->used;
+	memcpy(copy, key, len);
+	copy[len] = '\0';
+	c->used += len + 1;
+	return(copy);
+}
+
+static void
+chunksfree(Tchunk *c) {
+	while(c != NULL) {
+		Tchunk *next = c->next;
+		free(c);
+		c = next;
+	}
+}
+
+static void
+compact_rec(Trie *t, Tchunk *c) {
+	if(isbranch(t)) {
+		uint m = popcount(t->branch.bitmap);
+		for(uint i = 0; i < m; i++)
+			compact_rec(twig(t, i), c);
+	} else {
+		t->leaf.key = chunkcopy(c, t->leaf.key, leaflen(t));
+	}
+}
+
+// Copy the live keys, and a new key if pkey is not NULL, into one new
+// chunk and free the old chunks. The new key is copied before the old
+// chunks are freed in case it points into one of them. If allocation
+// fails the arena is left as it was.
+
+static bool
+compact(Tbl *tbl, const char **pkey, size_t len) {
+	size_t need = pkey == NULL ? 0 : len + 1;
+	Tchunk *c = chunknew(NULL, tbl->live + need);
+	if(c == NULL) return(false);
+	compact_rec(&tbl->root, c);
+	if(pkey != NULL) *pkey = chunkcopy(c, *pkey, len);
+	chunksfree(tbl->chunks);
+	tbl->chunks = c;
+	tbl->live += need;
+	tbl->dead = 0;
+	return(true);
+}
+
+// Copy a new key into the table's arena, compacting it if that is
+// worth doing.
+
+static const char *
+keycopy(Tbl *tbl, const char *key, size_t len) {
+	size_t need = len + 1;
+	Tchunk *c = tbl->chunks;
+	if(c != NULL && c->size - c->used >= need)
+		goto copy;
+	if(tbl->dead > tbl->live && compact(tbl, &key, len))
+		return(key);
+	// If that failed, try for a normal sized chunk.
+	c = chunknew(tbl->chunks, need);
+	if(c == NULL) return(NULL);
+	tbl->chunks = c;
+copy:
+	tbl->live += need;
+	return(chunkcopy(c, key, len));
+}
+
+static inline void
+keydrop(Tbl *tbl, size_t len) {
+	tbl->live -= len + 1;
+	tbl->dead += len + 1;
+}
+
+// After a delete, give memory back if most of the arena is dead and
+// there is at least a minimum chunk's worth of it. If compaction fails
+// we carry on with the old chunks.
+
+static inline void
+keytidy(Tbl *tbl) {
+	if(tbl->dead > tbl->live && tbl->dead >= Tchunkmin)
+		compact(tbl, NULL, 0);
+}
+
+static inline void
+keysinit(Tbl *tbl) {
+	tbl->chunks = NULL;
+	tbl->live = tbl->dead = 0;
+}
+
+static inline void
+keysfree(Tbl *tbl) {
+	chunksfree(tbl->chunks);
+}
+
+#else // borrowed keys
+
+static inline const char *
+keycopy(Tbl *tbl, const char *key, size_t len) {
+	(void)tbl; (void)len;
+	return(key);
+}
+
+static inline void
+keydrop(Tbl *tbl, size_t len) {
+	(void)tbl; (void)len;
+}
+
+static inline void
+keytidy(Tbl *tbl) {
+	(void)tbl;
+}
+
+static inline void
+keysinit(Tbl *tbl) {
+	(void)tbl;
+}
+
+static inline void
+keysfree(Tbl *tbl) {
+	(void)tbl;
+}
+
+#endif
+
+static void
+free_rec(Trie *t) {
+	if(!isbranch(t))
+		return;
+	uint m = popcount(t->branch.bitmap);
+	for(uint i = 0; i < m; i++)
+		free_rec(twig(t, i));
+	free(t->branch.twigs);
+}
+
+void
+Tfree(Tbl *tbl) {
+	if(tbl == NULL)
+		return;
+	free_rec(&tbl->root);
+	keysfree(tbl);
+	free(tbl);
+}
+
+Tclones
 Tbl *
 Tdelkv(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
 	if(tbl == NULL)
@@ -85,14 +424,20 @@ Tdelkv(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
 			return(tbl);
 		p = t; t = twig(t, twigoff(t, b));
 	}
-	if(strcmp(key, t->leaf.key) != 0)
+	if(!leafmatch(t, key, len))
 		return(tbl);
+#ifdef HAVE_OWNED_KEYS
+	*pkey = key;
+#else
 	*pkey = t->leaf.key;
+#endif
 	*pval = t->leaf.val;
 	if(p == NULL) {
+		keysfree(tbl);
 		free(tbl);
 		return(NULL);
 	}
+	keydrop(tbl, leaflen(t));
 	t = p; p = NULL; // Becuase t is the usual name
 	uint s, m; TWIGOFFMAX(s, m, t, b);
 	if(m == 2) {
@@ -100,6 +445,7 @@ Tdelkv(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
 		Trie *twigs = t->branch.twigs;
 		*t = *twig(t, !s);
 		free(twigs);
+		keytidy(tbl);
 		return(tbl);
 	}
 	memmove(t->branch.twigs+s, t->branch.twigs+s+1, sizeof(Trie) * (m - s - 1));
@@ -107,15 +453,24 @@ Tdelkv(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
 	// We have now correctly removed the twig from the trie, so if
 	// realloc() fails we can ignore it and continue to use the
 	// slightly oversized twig array.
-	Trie *twigs = realloc(t->branch.twigs, sizeof(Trie) * (m - 1));
-	if(twigs != NULL) t->branch.twigs = twigs;
+	if(twigcap(m - 1) < twigcap(m)) {
+		Trie *twigs = realloc(t->branch.twigs,
+		    sizeof(Trie) * twigcap(m - 1));
+		if(twigs != NULL) t->branch.twigs = twigs;
+	}
+	keytidy(tbl);
 	return(tbl);
 }
 
+Tclones
 Tbl *
 Tsetl(Tbl *tbl, const char *key, size_t len, void *val) {
 	// Ensure flag bits are zero.
+#ifdef HAVE_RAW_VALUES
+	if(((uint64_t)key >> 62) != 0) {
+#else
 	if(((uint64_t)val & 3) != 0) {
+#endif
 		errno = EINVAL;
 		return(NULL);
 	}
@@ -125,8 +480,13 @@ Tsetl(Tbl *tbl, const char *key, size_t len, void *val) {
 	if(tbl == NULL) {
 		tbl = malloc(sizeof(*tbl));
 		if(tbl == NULL) return(NULL);
-		tbl->root.leaf.key = key;
-		tbl->root.leaf.val = val;
+		keysinit(tbl);
+		const char *copy = keycopy(tbl, key, len);
+		if(copy == NULL) {
+			free(tbl);
+			return(NULL);
+		}
+		leafset(&tbl->root, copy, len, val);
 		return(tbl);
 	}
 	Trie *t = &tbl->root;
@@ -147,19 +507,45 @@ Tsetl(Tbl *tbl, const char *key, size_t len, void *val) {
 	}
 	// Do the keys differ, and if so, where?
 	size_t i;
+#ifdef HAVE_BINARY_KEYS
+	const char *tkey = t->leaf.key;
+	size_t tlen = t->leaf.len;
+	uint f = 0;
+	for(i = 0; i < len && i < tlen; i++) {
+		f = fold(key[i]) ^ fold(tkey[i]);
+		if(f != 0)
+			goto newkey;
+	}
+	if(len == tlen) {
+		t->leaf.val = val;
+		return(tbl);
+	}
+newkey:; // We have the branch's index; what are its flags?
+	// If one key is a prefix of the other, the shorter one ends
+	// at index i, which is detected by the upper nibble.
+	f = (f == 0 || (f & 0xf0)) ? 1 : 2;
+	Tbitmap b1 = keybit(key, len, i, f);
+	Tbitmap b2 = keybit(tkey, tlen, i, f);
+#else
 	for(i = 0; i <= len; i++) {
-		if(key[i] != t->leaf.key[i])
+		if(fold(key[i]) != fold(t->leaf.key[i]))
 			goto newkey;
 	}
 	t->leaf.val = val;
 	return(tbl);
 newkey:; // We have the branch's index; what are its flags?
-	byte k1 = (byte)key[i], k2 = (byte)t->leaf.key[i];
+	byte k1 = fold(key[i]), k2 = fold(t->leaf.key[i]);
 	uint f =  k1 ^ k2;
 	f = (f & 0xf0) ? 1 : 2;
-	// Prepare the new leaf.
 	Tbitmap b1 = nibbit(k1, f);
-	Trie t1 = { .leaf = { .key = key, .val = val } };
+	Tbitmap b2 = nibbit(k2, f);
+#endif
+	// Prepare the new leaf. Use the table's copy of the key from now
+	// on, because the caller's key may have been in a compacted chunk.
+	key = keycopy(tbl, key, len);
+	if(key == NULL) return(NULL);
+	Trie t1;
+	leafset(&t1, key, len, val);
 	// Find where to insert a branch or grow an existing branch.
 	t = &tbl->root;
 	while(isbranch(t)) {
@@ -176,9 +562,8 @@ newkey:; // We have the branch's index; what are its flags?
 	}
 newbranch:;
 	Trie *twigs = malloc(sizeof(Trie) * 2);
-	if(twigs == NULL) return(NULL);
+	if(twigs == NULL) goto nomem;
 	Trie t2 = *t; // Save before overwriting.
-	Tbitmap b2 = nibbit(k2, f);
 	t->branch.twigs = twigs;
 	t->branch.flags = f;
 	t->branch.index = i;
@@ -189,11 +574,17 @@ newbranch:;
 growbranch:;
 	assert(!hastwig(t, b1));
 	uint s, m; TWIGOFFMAX(s, m, t, b1);
-	twigs = realloc(t->branch.twigs, sizeof(Trie) * (m + 1));
-	if(twigs == NULL) return(NULL);
+	twigs = t->branch.twigs;
+	if(twigcap(m + 1) > twigcap(m)) {
+		twigs = realloc(twigs, sizeof(Trie) * twigcap(m + 1));
+		if(twigs == NULL) goto nomem;
+	}
 	memmove(twigs+s+1, twigs+s, sizeof(Trie) * (m - s));
 	memmove(twigs+s, &t1, sizeof(Trie));
 	t->branch.twigs = twigs;
 	t->branch.bitmap |= b1;
 	return(tbl);
+nomem:
+	keydrop(tbl, len);
+	return(NULL);
 }
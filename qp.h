@@ -72,15 +72,16 @@ typedef uint Tbitmap;
 
 #if defined(HAVE_NARROW_CPU) || defined(HAVE_SLOW_POPCOUNT)
 
-// NOTE: 16 bits only
+// NOTE: 16 bits only, plus the end-of-key bit with HAVE_BINARY_KEYS
 
 static inline uint
 popcount(Tbitmap w) {
+	uint top = w >> 16;
 	w -= (w >> 1) & 0x5555;
 	w = (w & 0x3333) + ((w >> 2) & 0x3333);
 	w = (w + (w >> 4)) & 0x0F0F;
 	w = (w + (w >> 8)) & 0x00FF;
-	return(w);
+	return(w + top);
 }
 
 #else
@@ -92,6 +93,21 @@ popcount(Tbitmap w) {
 
 #endif
 
+// With HAVE_TARGET_CLONES the functions that walk the trie are compiled
+// for CPUs with and without the POPCNT instruction, and the dynamic
+// linker picks a version when the program starts (using GNU ifunc), so
+// one binary runs everywhere and uses POPCNT where it can. This works
+// at the level of whole functions, because an indirect call for each
+// popcount would cost more than the SWAR code it replaces. A BMI2 PEXT
+// kernel does not help: a chunk is a contiguous run of bits, so a
+// shift and mask extracts it just as well.
+
+#ifdef HAVE_TARGET_CLONES
+#define Tclones __attribute__((target_clones("popcnt", "default")))
+#else
+#define Tclones
+#endif
+
 // Parallel popcount of the top and bottom 16 bits in a 32 bit word. This
 // is probably only a win if your CPU is short of registers and/or integer
 // units. NOTE: The caller needs to extract the results by masking with
@@ -109,10 +125,19 @@ popcount16x2(uint w) {
 // A trie node is two words on 64 bit machines, or three on 32 bit
 // machines. A node can be a leaf or a branch. In a leaf, the value
 // pointer must be word-aligned to allow for the tag bits.
+//
+// With HAVE_BINARY_KEYS, keys may contain '\0' bytes so the leaf has
+// a third word for the key's length. The leaf check compares the
+// lengths before comparing the keys with memcmp(). Branches have an
+// extra bitmap bit for the end of the key, which is distinct from a
+// '\0' byte, so one key can be a prefix of another.
 
 typedef struct Tleaf {
 	const char *key;
 	void *val;
+#ifdef HAVE_BINARY_KEYS
+	size_t len;
+#endif
 } Tleaf;
 
 // Branch nodes are distinguished from leaf nodes using a couple
@@ -148,21 +173,67 @@ typedef struct Tleaf {
 // bit offset allows, we can insert a stepping-stone branch with only
 // one twig. This would make the code a bit more complicated...
 
+// If HAVE_RAW_VALUES is defined the restriction moves to the key
+// pointer: the branch words are swapped round so that the flag bits
+// correspond to the most significant bits of the key pointer. These
+// are zero for user-space addresses on current 64 bit systems, so the
+// value can be any non-zero uintptr_t, e.g. a counter or ID.
+
+#ifdef HAVE_BINARY_KEYS
+#define Tbitmapbits 17
+#else
+#define Tbitmapbits 16
+#endif
+
+#ifdef HAVE_RAW_VALUES
+
+typedef struct Tbranch {
+	uint64_t
+		index : 62 - Tbitmapbits,
+		bitmap : Tbitmapbits,
+		flags : 2;
+	union Trie *twigs;
+} Tbranch;
+
+#else
+
 typedef struct Tbranch {
 	union Trie *twigs;
 	uint64_t
 		flags : 2,
-		index : 46,
-		bitmap : 16;
+		index : 62 - Tbitmapbits,
+		bitmap : Tbitmapbits;
 } Tbranch;
 
+#endif
+
 typedef union Trie {
 	struct Tleaf   leaf;
 	struct Tbranch branch;
 } Trie;
 
+// With HAVE_OWNED_KEYS the table copies each new key (plus a '\0')
+// into an arena made of a list of chunks, newest first. Keys are
+// bump-allocated from the newest chunk, and deleted keys are only
+// counted, not reused. When the dead bytes outnumber the live bytes,
+// the live keys are copied into one new chunk and the old chunks are
+// freed. This happens on insert when the newest chunk is full, and
+// on delete when at least a minimum-sized chunk's worth is dead, so
+// a table that only shrinks still gives memory back. Freeing the
+// table frees the keys one chunk at a time.
+
+typedef struct Tchunk {
+	struct Tchunk *next;
+	size_t size, used;
+	char data[];
+} Tchunk;
+
 struct Tbl {
 	union Trie root;
+#ifdef HAVE_OWNED_KEYS
+	Tchunk *chunks;
+	size_t live, dead;
+#endif
 };
 
 // Test flags to determine type of this node.
@@ -172,6 +243,55 @@ isbranch(Trie *t) {
 	return(t->branch.flags != 0);
 }
 
+// With HAVE_CASE_FOLD every key byte is passed through a 256 byte
+// folding map before it is used, so keys that differ only in case are
+// the same key. The map is applied when a nibble is extracted and when
+// keys are compared, so neither lookups nor inserts need a folded copy
+// of the key. A leaf keeps the key that was first inserted, and keys
+// are ordered by their folded bytes. The default map folds ASCII upper
+// case letters to lower case, which suits hostnames and HTTP headers;
+// a different map can be dropped in here, provided it maps only '\0'
+// to '\0'.
+
+#ifdef HAVE_CASE_FOLD
+
+#define FOLD1(c) ((c) >= 'A' && (c) <= 'Z' ? (c) - 'A' + 'a' : (c))
+#define FOLD4(c) FOLD1(c), FOLD1(c+1), FOLD1(c+2), FOLD1(c+3)
+#define FOLD16(c) FOLD4(c), FOLD4(c+4), FOLD4(c+8), FOLD4(c+12)
+#define FOLD64(c) FOLD16(c), FOLD16(c+16), FOLD16(c+32), FOLD16(c+48)
+
+static const byte foldmap[256] = {
+	FOLD64(0), FOLD64(64), FOLD64(128), FOLD64(192)
+};
+
+static inline byte
+fold(char c) {
+	return(foldmap[(byte)c]);
+}
+
+#else
+
+static inline byte
+fold(char c) {
+	return((byte)c);
+}
+
+#endif
+
+// Compare the first len bytes of two keys after folding.
+
+static inline bool
+foldeq(const char *k1, const char *k2, size_t len) {
+#ifdef HAVE_CASE_FOLD
+	for(size_t i = 0; i < len; i++)
+		if(fold(k1[i]) != fold(k2[i]))
+			return(false);
+	return(true);
+#else
+	return(memcmp(k1, k2, len) == 0);
+#endif
+}
+
 // Make a bitmask for testing a branch bitmap.
 //
 // mask:
@@ -181,21 +301,31 @@ isbranch(Trie *t) {
 // shift:
 // 1 -> 1 -> 4
 // 2 -> 0 -> 0
+//
+// With HAVE_BINARY_KEYS bit 0 is reserved for the end of the key.
 
 static inline Tbitmap
 nibbit(byte k, uint flags) {
 	uint mask = ((flags - 2) ^ 0x0f) & 0xff;
 	uint shift = (2 - flags) << 2;
+#ifdef HAVE_BINARY_KEYS
+	return(2 << ((k & mask) >> shift));
+#else
 	return(1 << ((k & mask) >> shift));
+#endif
 }
 
 // Extract a nibble from a key and turn it into a bitmask.
 
 static inline Tbitmap
-twigbit(Trie *t, const char *key, size_t len) {
-	uint64_t i = t->branch.index;
+keybit(const char *key, size_t len, size_t i, uint flags) {
 	if(i >= len) return(1);
-	return(nibbit((byte)key[i], t->branch.flags));
+	return(nibbit(fold(key[i]), flags));
+}
+
+static inline Tbitmap
+twigbit(Trie *t, const char *key, size_t len) {
+	return(keybit(key, len, t->branch.index, t->branch.flags));
 }
 
 static inline bool
@@ -213,7 +343,7 @@ twig(Trie *t, uint i) {
 	return(&t->branch.twigs[i]);
 }
 
-#ifdef HAVE_NARROW_CPU
+#if defined(HAVE_NARROW_CPU) && !defined(HAVE_BINARY_KEYS)
 
 #define TWIGOFFMAX(off, max, t, b) do {				\
 		Tbitmap bitmap = t->branch.bitmap;		\
@@ -231,3 +361,80 @@ twig(Trie *t, uint i) {
 	} while(0)
 
 #endif
+
+// Twig arrays can be allocated with some slack so that a mutate-heavy
+// workload does not call realloc() every time a twig is added or
+// removed. The capacity of a twig array is a function of the number of
+// twigs, so it does not need to be stored in the branch. TWIG_SLACK
+// selects the size classes:
+//
+// 0 -> exact fit, realloc() on every change (the default)
+// 1 -> round up to an even number of twigs
+// 2 -> round up to a power of two
+//
+// Deletes shrink the array lazily, only when the number of twigs
+// drops into a smaller size class. A new branch always has two twigs,
+// which is the smallest size class for every policy.
+
+#ifndef TWIG_SLACK
+#define TWIG_SLACK 0
+#endif
+
+static inline uint
+twigcap(uint m) {
+#if TWIG_SLACK == 2
+	return(m <= 2 ? 2 : 1U << (32 - __builtin_clz(m - 1)));
+#elif TWIG_SLACK == 1
+	return((m + 1) & ~1U);
+#else
+	return(m);
+#endif
+}
+
+// Leaf accessors that depend on whether keys are '\0' terminated.
+
+static inline void
+leafset(Trie *t, const char *key, size_t len, void *val) {
+	t->leaf.key = key;
+	t->leaf.val = val;
+#ifdef HAVE_BINARY_KEYS
+	t->leaf.len = len;
+#else
+	(void)len;
+#endif
+}
+
+#ifdef HAVE_BINARY_KEYS
+
+static inline size_t
+leaflen(Trie *t) {
+	return(t->leaf.len);
+}
+
+static inline bool
+leafmatch(Trie *t, const char *key, size_t len) {
+	return(len == t->leaf.len && foldeq(key, t->leaf.key, len));
+}
+
+#else
+
+static inline size_t
+leaflen(Trie *t) {
+	return(strlen(t->leaf.key));
+}
+
+static inline bool
+leafmatch(Trie *t, const char *key, size_t len) {
+	(void)len;
+#ifdef HAVE_CASE_FOLD
+	const char *tkey = t->leaf.key;
+	for(size_t i = 0; fold(key[i]) == fold(tkey[i]); i++)
+		if(key[i] == '\0')
+			return(true);
+	return(false);
+#else
+	return(strcmp(key, t->leaf.key) == 0);
+#endif
+}
+
+#endif
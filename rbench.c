@@ -0,0 +1,170 @@
+// rbench.c: prefix table benchmark.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/time.h>
+
+#include "Rtbl.h"
+
+typedef unsigned char byte;
+typedef unsigned int uint;
+
+static const char *progname;
+
+static void
+die(const char *cause) {
+	fprintf(stderr, "%s: %s: %s\n", progname, cause, strerror(errno));
+	exit(1);
+}
+
+static void
+usage(void) {
+	fprintf(stderr,
+"usage: %s <seed> <count> <prefixes>\n"
+"	The seed must be at least 12 characters.\n"
+"	Random IPv4 and IPv6 tables with <prefixes> routes are\n"
+"	loaded, then searched and mutated <count> times.\n"
+		, progname);
+	exit(1);
+}
+
+static struct timeval tu;
+
+static void
+start(const char *s) {
+	printf("%s... ", s);
+	gettimeofday(&tu, NULL);
+}
+
+static void
+done(void) {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	tv.tv_sec -= tu.tv_sec;
+	tv.tv_usec -= tu.tv_usec;
+	if(tv.tv_usec < 0) {
+		tv.tv_sec -= 1;
+		tv.tv_usec += 1000000;
+	}
+	printf("%ld.%06ld s\n", (long)tv.tv_sec, (long)tv.tv_usec);
+}
+
+static int
+ssrandom(char *s) {
+	// initialize random(3) from a string
+	size_t len = strlen(s);
+	if(len < 12) return(-1);
+	unsigned seed = s[0] | s[1] << 8 | s[2] << 16 | s[3] << 24;
+	initstate(seed, s+4, len-4);
+	return(0);
+}
+
+typedef struct Prefix {
+	byte addr[Rmaxlen / 8];
+	uint plen;
+} Prefix;
+
+// Prefix lengths roughly like a BGP table: IPv4 is dominated by /24s
+// with most of the rest between /16 and /23; IPv6 by /48s and /32s
+// with most of the rest in between.
+
+static uint
+plen4(void) {
+	uint r = (uint)random() % 100;
+	if(r < 60) return(24);
+	if(r < 95) return(16 + (uint)random() % 8);
+	return(8 + (uint)random() % 8);
+}
+
+static uint
+plen6(void) {
+	uint r = (uint)random() % 100;
+	if(r < 45) return(48);
+	if(r < 60) return(32);
+	if(r < 95) return(33 + (uint)random() % 15);
+	return(64);
+}
+
+static void
+bench(const char *name, uint (*plen)(void), uint alen,
+    Prefix *p, size_t n, int N) {
+	// Keep IPv4 routes out of the multicast space and IPv6 routes
+	// inside 2000::/3, like real allocations.
+	for(size_t i = 0; i < n; i++) {
+		for(uint j = 0; j < Rmaxlen / 8; j++)
+			p[i].addr[j] = (byte)(random() >> 23);
+		if(alen == 32)
+			p[i].addr[0] &= 0xDF;
+		else
+			p[i].addr[0] = (p[i].addr[0] & 0x1F) | 0x20;
+		p[i].plen = plen();
+	}
+	byte (*addr)[Rmaxlen / 8] = calloc((size_t)N, sizeof(*addr));
+	if(addr == NULL) die("calloc");
+	for(int i = 0; i < N; i++) {
+		memcpy(addr[i], p[(size_t)random() % n].addr, sizeof(*addr));
+		addr[i][alen / 8 - 1] ^= (byte)(random() >> 23);
+	}
+	printf("- %s %zu prefixes\n", name, n);
+
+	start("load");
+	Rtbl *t = NULL;
+	for(size_t i = 0; i < n; i++)
+		t = Rset(t, p[i].addr, p[i].plen, &p[i]);
+	done();
+
+	start("lpm");
+	uint found = 0, len = 0;
+	for(int i = 0; i < N; i++)
+		if(Rlpm(t, addr[i], alen, &len) != NULL)
+			found += 1;
+	done();
+	printf("- %u matched\n", found);
+
+	start("mutate");
+	for(int i = 0; i < N; i++) {
+		Prefix *q = &p[(size_t)random() % n];
+		t = Rset(t, q->addr, q->plen, random() % 2 ? q : NULL);
+	}
+	done();
+
+	// ensure all prefixes present
+	for(size_t i = 0; i < n; i++)
+		t = Rset(t, p[i].addr, p[i].plen, &p[i]);
+	start("free");
+	for(size_t i = 0; i < n; i++)
+		t = Rdel(t, p[i].addr, p[i].plen);
+	assert(t == NULL);
+	done();
+
+	free(addr);
+}
+
+int
+main(int argc, char *argv[]) {
+	progname = argv[0];
+	if(argc != 4 || argv[1][0] == '-') usage();
+	if(ssrandom(argv[1]) < 0) usage();
+	int N = atoi(argv[2]);
+	size_t n = (size_t)atol(argv[3]);
+	if(N < 0 || n == 0) usage();
+
+	Prefix *p = calloc(n, sizeof(*p));
+	if(p == NULL) die("calloc");
+
+	bench("ipv4", plen4, 32, p, n, N);
+	bench("ipv6", plen6, 128, p, n, N);
+
+	free(p);
+	return(0);
+}
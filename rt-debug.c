@@ -0,0 +1,58 @@
+// rt-debug.c: rt trie debug support
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Rtbl.h"
+#include "rt.h"
+
+static void
+dump_rec(Rnode *n, uint d) {
+	printf("Rdump%*s node %p twigs %04x prefixes %04x\n", d*2, "",
+	    n, n->twigmap, n->pfxmap);
+	for(uint i = 0; i < 15; i++) {
+		Tbitmap p = 1U << i;
+		if(n->pfxmap & p)
+			printf("Rdump%*s prefix /%u %p\n", d*2, "",
+			    d * 4 + pfxlen(p), vals(n)[pfxoff(n, p)]);
+	}
+	for(uint i = 0; i < 16; i++) {
+		Tbitmap b = 1U << i;
+		if(n->twigmap & b) {
+			printf("Rdump%*s twig %x\n", d*2, "", i);
+			dump_rec(&n->twigs[twigoff(n, b)], d+1);
+		}
+	}
+}
+
+void
+Rdump(Rtbl *tbl) {
+	printf("Rdump root %p\n", tbl);
+	if(tbl != NULL)
+		dump_rec(&tbl->root, 0);
+}
+
+static void
+size_rec(Rnode *n, size_t *rsize, size_t *rnodes, size_t *rprefixes) {
+	*rsize += sizeof(*n) + sizeof(void *) * pfxmax(n);
+	*rnodes += 1;
+	*rprefixes += pfxmax(n);
+	for(uint i = 0; i < twigmax(n); i++)
+		size_rec(&n->twigs[i], rsize, rnodes, rprefixes);
+}
+
+void
+Rsize(Rtbl *tbl, const char **rtype,
+    size_t *rsize, size_t *rnodes, size_t *rprefixes) {
+	*rtype = "rt";
+	*rsize = *rnodes = *rprefixes = 0;
+	if(tbl != NULL)
+		size_rec(&tbl->root, rsize, rnodes, rprefixes);
+}
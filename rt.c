@@ -0,0 +1,194 @@
+// rt.c: prefix tables implemented with tree bitmap tries.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Rtbl.h"
+#include "rt.h"
+
+void *
+Rget(Rtbl *tbl, const void *addr, uint plen) {
+	if(tbl == NULL || plen > Rmaxlen)
+		return(NULL);
+	Rnode *n = &tbl->root;
+	uint d;
+	for(d = 0; d * 4 + 4 <= plen; d++) {
+		Tbitmap b = 1U << nibble(addr, d);
+		if(!(n->twigmap & b))
+			return(NULL);
+		n = &n->twigs[twigoff(n, b)];
+	}
+	uint l = plen - d * 4;
+	Tbitmap p = pfxbit(l ? nibble(addr, d) : 0, l);
+	if(!(n->pfxmap & p))
+		return(NULL);
+	return(vals(n)[pfxoff(n, p)]);
+}
+
+void *
+Rlpm(Rtbl *tbl, const void *addr, uint alen, uint *rplen) {
+	if(tbl == NULL)
+		return(NULL);
+	if(alen > Rmaxlen)
+		alen = Rmaxlen;
+	// As in the Tree Bitmap paper, we only remember the deepest node
+	// with a matching prefix, and get its value after the descent.
+	Rnode *n = &tbl->root, *best = NULL;
+	Tbitmap bestbit = 0;
+	uint bestd = 0;
+	for(uint d = 0 ;; d++) {
+		__builtin_prefetch(n->twigs);
+		uint rem = alen - d * 4;
+		uint k = rem ? nibble(addr, d) : 0;
+		Tbitmap hits = n->pfxmap & pfxmask(k, rem);
+		if(hits) {
+			best = n;
+			bestbit = 1U << (31 - __builtin_clz(hits));
+			bestd = d;
+		}
+		if(rem < 4)
+			break;
+		Tbitmap b = 1U << k;
+		if(!(n->twigmap & b))
+			break;
+		n = &n->twigs[twigoff(n, b)];
+	}
+	if(best == NULL)
+		return(NULL);
+	*rplen = bestd * 4 + pfxlen(bestbit);
+	return(vals(best)[pfxoff(best, bestbit)]);
+}
+
+// Remove an empty child node from its parent's twig array.
+
+static void
+deltwig(Rnode *n, Tbitmap b) {
+	uint s = twigoff(n, b), m = twigmax(n), v = pfxmax(n);
+	Rnode *twigs = n->twigs;
+	memmove(twigs+s, twigs+s+1, sizeof(Rnode) * (m - s - 1));
+	memmove(twigs+m-1, twigs+m, sizeof(void *) * v);
+	n->twigmap &= ~b;
+	if(m - 1 + v == 0) {
+		free(twigs);
+		n->twigs = NULL;
+		return;
+	}
+	// We have now correctly removed the twig from the trie, so if
+	// realloc() fails we can ignore it and continue to use the
+	// slightly oversized array.
+	twigs = realloc(twigs, nodesize(m - 1, v));
+	if(twigs != NULL) n->twigs = twigs;
+}
+
+// Work back up the path from node n at depth d removing empty nodes.
+// Returns NULL if the whole table is empty and has been freed.
+
+static Rtbl *
+prune(Rtbl *tbl, Rnode *path[], uint d, const void *addr, Rnode *n) {
+	while(n->twigmap == 0 && n->pfxmap == 0) {
+		if(d == 0) {
+			free(tbl);
+			return(NULL);
+		}
+		n = path[--d];
+		deltwig(n, 1U << nibble(addr, d));
+	}
+	return(tbl);
+}
+
+Rtbl *
+Rdel(Rtbl *tbl, const void *addr, uint plen) {
+	if(tbl == NULL || plen > Rmaxlen)
+		return(tbl);
+	// Remember the path so that we can remove empty nodes.
+	Rnode *path[Rmaxlen / 4 + 1];
+	Rnode *n = &tbl->root;
+	uint d;
+	for(d = 0; d * 4 + 4 <= plen; d++) {
+		Tbitmap b = 1U << nibble(addr, d);
+		if(!(n->twigmap & b))
+			return(tbl);
+		path[d] = n;
+		n = &n->twigs[twigoff(n, b)];
+	}
+	uint l = plen - d * 4;
+	Tbitmap p = pfxbit(l ? nibble(addr, d) : 0, l);
+	if(!(n->pfxmap & p))
+		return(tbl);
+	uint s = pfxoff(n, p), m = twigmax(n), v = pfxmax(n);
+	void **vs = vals(n);
+	memmove(vs+s, vs+s+1, sizeof(void *) * (v - s - 1));
+	n->pfxmap &= ~p;
+	if(m + v - 1 == 0) {
+		free(n->twigs);
+		n->twigs = NULL;
+	} else {
+		Rnode *twigs = realloc(n->twigs, nodesize(m, v - 1));
+		if(twigs != NULL) n->twigs = twigs;
+	}
+	return(prune(tbl, path, d, addr, n));
+}
+
+Rtbl *
+Rset(Rtbl *tbl, const void *addr, uint plen, void *val) {
+	if(plen > Rmaxlen) {
+		errno = EINVAL;
+		return(NULL);
+	}
+	if(val == NULL)
+		return(Rdel(tbl, addr, plen));
+	// First prefix in an empty tbl?
+	if(tbl == NULL) {
+		tbl = calloc(1, sizeof(*tbl));
+		if(tbl == NULL) return(NULL);
+	}
+	// Find or create the nodes down to the prefix's nibble. If an
+	// allocation fails we remove the empty nodes we created on the
+	// way, and free the table if it was new.
+	Rnode *path[Rmaxlen / 4 + 1];
+	Rnode *n = &tbl->root;
+	uint d;
+	for(d = 0; d * 4 + 4 <= plen; d++) {
+		Tbitmap b = 1U << nibble(addr, d);
+		uint s = twigoff(n, b);
+		if(!(n->twigmap & b)) {
+			uint m = twigmax(n), v = pfxmax(n);
+			Rnode *twigs = realloc(n->twigs, nodesize(m + 1, v));
+			if(twigs == NULL) goto fail;
+			memmove(twigs+m+1, twigs+m, sizeof(void *) * v);
+			memmove(twigs+s+1, twigs+s, sizeof(Rnode) * (m - s));
+			memset(twigs+s, 0, sizeof(Rnode));
+			n->twigs = twigs;
+			n->twigmap |= b;
+		}
+		path[d] = n;
+		n = &n->twigs[s];
+	}
+	uint l = plen - d * 4;
+	Tbitmap p = pfxbit(l ? nibble(addr, d) : 0, l);
+	uint s = pfxoff(n, p);
+	if(n->pfxmap & p) {
+		vals(n)[s] = val;
+		return(tbl);
+	}
+	uint m = twigmax(n), v = pfxmax(n);
+	Rnode *twigs = realloc(n->twigs, nodesize(m, v + 1));
+	if(twigs == NULL) goto fail;
+	n->twigs = twigs;
+	void **vs = vals(n);
+	memmove(vs+s+1, vs+s, sizeof(void *) * (v - s));
+	vs[s] = val;
+	n->pfxmap |= p;
+	return(tbl);
+fail:
+	prune(tbl, path, d, addr, n);
+	return(NULL);
+}
@@ -0,0 +1,131 @@
+// rt.h: prefix tables implemented with tree bitmap tries.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+// See qp.h for introductory comments about tries, and
+// blog-2016-02-23.md for how qp tries relate to routing tries.
+//
+// This is a Tree Bitmap trie (Eatherton, Varghese, Dittia, 2004)
+// built with the qp trie's popcount machinery. Each node consumes a
+// nibble of the address, and has two bitmaps: the twig bitmap says
+// which of the 16 possible child nodes are present, like a qp branch;
+// the prefix bitmap says which of the 15 possible prefixes that end
+// inside this nibble (of lengths 0, 1, 2, and 3 bits) are present.
+//
+// The prefix bitmap is laid out like a binary heap: bit 0 is the
+// zero-length prefix, bits 1-2 are the 1-bit prefixes, bits 3-6 are
+// the 2-bit prefixes, and bits 7-14 are the 3-bit prefixes. So the
+// longest matching prefix in a node is the highest set bit in the
+// intersection of the prefix bitmap and the four bits for the nibble.
+//
+// A node is two words, a pointer and the two bitmaps. The pointer
+// refers to an array of child nodes followed by an array of prefix
+// values, both of which are compressed using the popcount trick.
+//
+// [ twigs maps ] -> [ twigs maps ] [ twigs maps ] [ value ] [ value ]
+//
+// Unlike a qp trie there are no leaves and no skipped nibbles, so
+// every prefix has the same place in the trie regardless of what
+// other prefixes are present. A lookup never needs to go back and
+// check a key. An address of n bits uses at most n/4 + 1 nodes.
+
+typedef unsigned char byte;
+typedef unsigned int uint;
+
+typedef uint Tbitmap;
+
+#if defined(HAVE_SLOW_POPCOUNT)
+
+// NOTE: 16 bits only
+
+static inline uint
+popcount(Tbitmap w) {
+	w -= (w >> 1) & 0x5555;
+	w = (w & 0x3333) + ((w >> 2) & 0x3333);
+	w = (w + (w >> 4)) & 0x0F0F;
+	w = (w + (w >> 8)) & 0x00FF;
+	return(w);
+}
+
+#else
+
+static inline uint
+popcount(Tbitmap w) {
+	return((uint)__builtin_popcount(w));
+}
+
+#endif
+
+typedef struct Rnode {
+	struct Rnode *twigs;
+	uint32_t twigmap : 16,
+	         pfxmap : 16;
+} Rnode;
+
+struct Rtbl {
+	Rnode root;
+};
+
+// Extract the nibble at depth d from an address.
+
+static inline uint
+nibble(const byte *addr, uint d) {
+	return((addr[d / 2] >> (d % 2 ? 0 : 4)) & 0xF);
+}
+
+// The prefix bitmap bit for a prefix of l bits (0 <= l < 4) of a nibble.
+
+static inline Tbitmap
+pfxbit(uint k, uint l) {
+	return(1U << ((1U << l) - 1 + (k >> (4 - l))));
+}
+
+// The prefix bitmap bits for prefixes of a nibble up to l bits long.
+
+static inline Tbitmap
+pfxmask(uint k, uint l) {
+	Tbitmap m = 0;
+	for(uint i = 0; i <= l && i < 4; i++)
+		m |= pfxbit(k, i);
+	return(m);
+}
+
+// The length of the prefix for a prefix bitmap bit.
+
+static inline uint
+pfxlen(Tbitmap b) {
+	uint i = 31 - (uint)__builtin_clz(b);
+	return(31 - (uint)__builtin_clz(i + 1));
+}
+
+static inline uint
+twigmax(Rnode *n) {
+	return(popcount(n->twigmap));
+}
+
+static inline uint
+twigoff(Rnode *n, Tbitmap b) {
+	return(popcount(n->twigmap & (b-1)));
+}
+
+static inline uint
+pfxmax(Rnode *n) {
+	return(popcount(n->pfxmap));
+}
+
+static inline uint
+pfxoff(Rnode *n, Tbitmap b) {
+	return(popcount(n->pfxmap & (b-1)));
+}
+
+static inline void **
+vals(Rnode *n) {
+	return((void **)(n->twigs + twigmax(n)));
+}
+
+static inline size_t
+nodesize(uint twigs, uint pfxs) {
+	return(sizeof(Rnode) * twigs + sizeof(void *) * pfxs);
+}
@@ -0,0 +1,127 @@
+// rtest.c: test prefix table implementations.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Rtbl.h"
+
+typedef unsigned char byte;
+typedef unsigned int uint;
+
+static const char *progname;
+
+static void
+die(const char *cause) {
+	fprintf(stderr, "%s: %s: %s\n", progname, cause, strerror(errno));
+	exit(1);
+}
+
+static void
+usage(void) {
+	fprintf(stderr,
+"usage: %s <count>\n"
+"	Make a reproducible random set of <count> nested IPv4 and IPv6\n"
+"	prefixes and print the results of some lookups, for comparing\n"
+"	different implementations.\n"
+	    , progname);
+	exit(1);
+}
+
+typedef struct Prefix {
+	byte addr[Rmaxlen / 8];
+	uint plen;
+} Prefix;
+
+// Copy the first plen bits of an address and randomize the rest.
+
+static void
+extend(byte *dst, const byte *src, uint plen) {
+	for(uint i = 0; i < Rmaxlen / 8; i++) {
+		byte mask = i < plen / 8 ? 0xFF : i > plen / 8 ? 0x00 :
+		    (byte)(0xFF00 >> (plen % 8));
+		dst[i] = (src[i] & mask) | ((byte)random() & ~mask);
+	}
+}
+
+static void
+test(uint alen, size_t count) {
+	Prefix *p = calloc(count, sizeof(*p));
+	if(p == NULL) die("calloc");
+	Rtbl *t = NULL;
+	// Half of the prefixes are random, and half are more specific
+	// than an earlier prefix, so there are plenty of nested routes.
+	for(size_t i = 0; i < count; i++) {
+		byte zero[Rmaxlen / 8] = { 0 };
+		if(i > 0 && random() % 2) {
+			Prefix *q = &p[(size_t)random() % i];
+			p[i].plen = q->plen + (uint)random() % (alen - q->plen + 1);
+			extend(p[i].addr, q->addr, q->plen);
+		} else {
+			p[i].plen = (uint)random() % (alen + 1);
+			extend(p[i].addr, zero, 0);
+		}
+		errno = 0;
+		t = Rset(t, p[i].addr, p[i].plen, &p[i]);
+		if(t == NULL) die("Rtbl");
+	}
+	// Delete a quarter of them.
+	for(size_t i = 0; i < count / 4; i++) {
+		Prefix *q = &p[(size_t)random() % count];
+		errno = 0;
+		t = Rdel(t, q->addr, q->plen);
+		if(t == NULL && errno != 0) die("Rtbl");
+	}
+	size_t size, nodes, prefixes;
+	const char *type;
+	Rsize(t, &type, &size, &nodes, &prefixes);
+	fprintf(stderr, "SIZE %s prefixes=%zu nodes=%zu bytes/prefix=%.2f\n",
+	    type, prefixes, nodes, (double)size / prefixes);
+	// Exact lookups, and longest prefix matches for addresses
+	// inside the prefixes and random addresses.
+	for(size_t i = 0; i < count; i++) {
+		Prefix *q = Rget(t, p[i].addr, p[i].plen);
+		putchar(q == NULL ? '=' : '*');
+	}
+	putchar('\n');
+	for(size_t i = 0; i < count * 2; i++) {
+		byte addr[Rmaxlen / 8];
+		Prefix *q = &p[(size_t)random() % count];
+		if(i % 2)
+			extend(addr, q->addr, q->plen);
+		else
+			extend(addr, q->addr, 0);
+		uint len = 0;
+		q = Rlpm(t, addr, alen, &len);
+		if(q == NULL)
+			printf("-\n");
+		else
+			printf("%zu /%u\n", (size_t)(q - p), len);
+	}
+	for(size_t i = 0; i < count; i++)
+		t = Rdel(t, p[i].addr, p[i].plen);
+	assert(t == NULL);
+	free(p);
+}
+
+int
+main(int argc, char *argv[]) {
+	progname = argv[0];
+	if(argc != 2 || argv[1][0] == '-')
+		usage();
+	size_t count = (size_t)atol(argv[1]);
+	if(count == 0)
+		usage();
+	srandom(1);
+	test(32, count);
+	test(128, count);
+	return(0);
+}
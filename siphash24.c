@@ -16,8 +16,12 @@
 #include <string.h>
 
 /* default: SipHash-2-4 */
+#ifndef cROUNDS
 #define cROUNDS 2
+#endif
+#ifndef dROUNDS
 #define dROUNDS 4
+#endif
 
 #define ROTL(x,b) (uint64_t)( ((x) << (b)) | ( (x) >> (64 - (b))) )
 
@@ -0,0 +1,44 @@
+#!/usr/bin/perl
+
+use warnings;
+use strict;
+
+if (@ARGV < 1) {
+	die <<EOF;
+usage: $0 <count>
+	Emit <count> binary keys, for use as the <file> argument of
+	test-gen.pl with the HAVE_BINARY_KEYS variants. They contain
+	'\\0' and '\\xff' bytes, one is empty, and many are prefixes of
+	other keys. None contain '\\n', which separates them.
+EOF
+}
+
+my $n = shift;
+
+# bytes that are likely to upset code that expects C strings
+my @edge = map { chr } 0x00, 0x01, 0x7f, 0x80, 0xfe, 0xff, ord 'a';
+
+sub edgy {
+	return join '', map { $edge[rand @edge] } 1 .. shift;
+}
+
+sub bytes {
+	return join '', map { chr(int rand 255) =~ tr/\n/\xff/r } 1 .. shift;
+}
+
+# the empty key
+print "\n";
+my $i = 1;
+
+# chains of keys, each a prefix of the next
+while ($i < $n / 2) {
+	my $key = edgy(1 + int rand 12);
+	for (my $j = 1; $j <= length $key and $i < $n; $j++, $i++) {
+		print substr($key, 0, $j), "\n";
+	}
+}
+
+# short keys mostly made of edge bytes, and longer random ones
+while ($i < $n) {
+	print +($i++ % 2 ? edgy(1 + int rand 6) : bytes(1 + int rand 24)), "\n";
+}
@@ -0,0 +1,32 @@
+#!/usr/bin/perl
+
+use warnings;
+use strict;
+
+if (@ARGV < 1) {
+	die <<EOF;
+usage: $0 <count>
+	Emit <count> integer keys as 16 digit hexadecimal strings,
+	for use as the <file> argument of test-gen.pl. A third are
+	dense, a third are sparse, and a third are clustered.
+EOF
+}
+
+my $n = shift;
+my $third = int($n / 3);
+
+# dense
+printf "%016x\n", $_ for 0 .. $third - 1;
+
+# sparse
+printf "%08x%08x\n", rand 2**32, rand 2**32 for 1 .. $third;
+
+# clustered: runs of sequential keys at random places
+for (my $i = 2 * $third; $i < $n; ) {
+	my $hi = int rand 2**32;
+	my $lo = int rand 2**32 - 256;
+	my $run = 1 + int rand 256;
+	for (my $j = 0; $j < $run and $i < $n; $j++, $i++) {
+		printf "%08x%08x\n", $hi, $lo + $j;
+	}
+}
@@ -65,14 +65,14 @@ main(int argc, char *argv[]) {
 		default:
 			usage();
 		case('*'):
-			if(Tget(t, key))
+			if(Tgetl(t, key, len))
 				putchar('*');
 			else
 				putchar('=');
 			continue;
 		case('+'):
 			errno = 0;
-			void *val = Tget(t, key);
+			void *val = Tgetl(t, key, len);
 			t = Tsetl(t, key, len, val == NULL ? key : val);
 			if(t == NULL)
 				die("Tbl");
@@ -91,7 +91,7 @@ main(int argc, char *argv[]) {
 			if(rkey)
 				trace(t, s, key);
 			free(key);
-			free(rkey);
+			free(rval);
 			continue;
 		}
 	}
@@ -101,25 +101,47 @@ main(int argc, char *argv[]) {
 	size_t size, depth, branches, leaves;
 	const char *type;
 	Tsize(t, &type, &size, &depth, &branches, &leaves);
-	size_t overhead = size / sizeof(void*) - 2 * leaves;
+	// Overhead is measured relative to a two-word key+value leaf,
+	// so it can be negative for a set that has no value words.
+	double overhead = (double)(size / sizeof(void*)) - 2.0 * leaves;
 	fprintf(stderr, "SIZE %s leaves=%zu branches=%zu overhead=%.2f depth=%.2f\n",
 		type, leaves, branches,
-		(double)overhead / leaves,
+		overhead / leaves,
 		(double)depth / leaves);
+	// Use the explicit-length API so that keys can contain '\0'
 	const char *key = NULL;
+	size_t len = 0, plen = 0;
 	void *val = NULL, *prev = NULL;
-	while(Tnext(t, &key, &val)) {
-		assert(key == val);
-		puts(key);
+	// Check that Tfree() can free a non-empty table. It frees a copy
+	// so that the keys and values here stay intact.
+	Tbl *u = NULL;
+	while(Tnextl(t, &key, &len, &val)) {
+		u = Tsetl(u, key, len, val);
+		if(u == NULL)
+			die("Tbl");
+	}
+	Tfree(u);
+	key = NULL;
+	len = 0;
+	while(Tnextl(t, &key, &len, &val)) {
+		// The value is our copy of the key; the table might
+		// have its own copy.
+		assert(memcmp(key, val, len) == 0);
+		fwrite(key, 1, len, stdout);
+		putchar('\n');
 		if(prev) {
-			t = Tdel(t, prev);
+			t = Tdell(t, prev, plen);
 			trace(t, '!', prev);
 			free(prev);
 		}
 		prev = val;
+		plen = len;
+		// Deleting can move the table's copy of the key, so
+		// carry on from ours.
+		key = val;
 	}
 	if(prev) {
-		t = Tdel(t, prev);
+		t = Tdell(t, prev, plen);
 		free(prev);
 	}
 	return(0);
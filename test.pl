@@ -5,13 +5,21 @@
 use warnings;
 use strict;
 
+# With -i, keys are ASCII case-insensitive, like HAVE_CASE_FOLD:
+# the table keeps the first spelling of a key, and keys are sorted
+# in lower case.
+my $fold = @ARGV && $ARGV[0] eq '-i' && shift;
+
 my %t;
 
 while(<>) {
-	m{^([-+*])(.*)$}s or die "bad input line";
-	delete $t{$2} if $1 eq '-';
-	$t{$2} = 1 if $1 eq '+';
-	print $t{$2} ? "*" : "=" if $1 eq '*';
+	m{^([-+*])(.*)$} or die "bad input line";
+	my $k = $fold ? lc $2 : $2;
+	delete $t{$k} if $1 eq '-';
+	$t{$k} //= $2 if $1 eq '+';
+	print exists $t{$k} ? "*" : "=" if $1 eq '*';
 }
 print "\n";
-print for sort keys %t;
+# keys do not include the newline, so that the sort order is correct
+# when keys contain bytes that sort before it
+print "$t{$_}\n" for sort keys %t;
@@ -0,0 +1,135 @@
+// valtest.c: test tables whose values can be any non-zero integer.
+//
+// Written by Tony Finch <dot@dotat.at>
+// You may do anything with this. It has no warranty.
+// <http://creativecommons.org/publicdomain/zero/1.0/>
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Tbl.h"
+
+static const char *progname;
+
+static void
+die(const char *cause) {
+	fprintf(stderr, "%s: %s: %s\n", progname, cause, strerror(errno));
+	exit(1);
+}
+
+static void
+fail(const char *what, const char *key) {
+	fprintf(stderr, "%s: %s mismatch for %s\n", progname, what, key);
+	exit(1);
+}
+
+static void
+usage(void) {
+	fprintf(stderr,
+"usage: %s <count>\n"
+"	Store <count> keys whose values are integers with their low\n"
+"	or high bits set, as allowed by HAVE_RAW_VALUES, and check\n"
+"	that they survive lookups, iteration and deletion.\n"
+	    , progname);
+	exit(1);
+}
+
+// Key i is i in decimal, so a key tells us its expected value, which
+// is odd, has its low tag bits set, has its high bits set, or has one
+// bit set, depending on i.
+
+static void *
+value(size_t i) {
+	uintptr_t v;
+	switch(i % 4) {
+	case(0):
+		v = i * 2 + 1;
+		break;
+	case(1):
+		v = i * 8 + 3;
+		break;
+	case(2):
+		v = ~(uintptr_t)i;
+		break;
+	default:
+		v = (uintptr_t)1 << (i % (sizeof(v) * 8));
+		break;
+	}
+	return((void *)v);
+}
+
+static size_t
+keyindex(const char *key) {
+	return((size_t)strtoul(key, NULL, 10));
+}
+
+// Check every key from 0 to n, of which those in [lo,n) with the
+// given parity (or any parity if step is 1) should be present, and
+// check that iteration finds exactly those in order.
+
+static void
+check(Tbl *t, size_t n, size_t lo, size_t step) {
+	char key[32];
+	size_t count = 0;
+	for(size_t i = 0; i < n; i++) {
+		snprintf(key, sizeof(key), "%zu", i);
+		bool present = i >= lo && (i - lo) % step == 0;
+		void *val = Tget(t, key);
+		if(val != (present ? value(i) : NULL))
+			fail("Tget", key);
+		count += present;
+	}
+	const char *k = NULL, *prev = NULL;
+	size_t len = 0;
+	void *val;
+	while(Tnextl(t, &k, &len, &val)) {
+		if(len != strlen(k) || val != value(keyindex(k)))
+			fail("Tnextl", k);
+		if(prev != NULL && strcmp(prev, k) >= 0)
+			fail("Tnextl order", k);
+		prev = k;
+		count -= 1;
+	}
+	if(count != 0)
+		fail("Tnextl count", "");
+}
+
+int
+main(int argc, char *argv[]) {
+	progname = argv[0];
+	if(argc != 2 || argv[1][0] == '-')
+		usage();
+	size_t n = (size_t)atol(argv[1]);
+	char **key = malloc(sizeof(*key) * (n + 1));
+	if(key == NULL)
+		die("malloc");
+	Tbl *t = NULL;
+	for(size_t i = 0; i < n; i++) {
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%zu", i);
+		key[i] = strdup(buf);
+		if(key[i] == NULL)
+			die("strdup");
+		t = Tset(t, key[i], value(i));
+		if(t == NULL)
+			die("Tbl");
+	}
+	check(t, n, 0, 1);
+	// Delete the odd keys, then the even keys.
+	for(size_t i = 1; i < n; i += 2)
+		t = Tdel(t, key[i]);
+	check(t, n, 0, 2);
+	for(size_t i = 0; i < n; i += 2)
+		t = Tdel(t, key[i]);
+	if(t != NULL)
+		fail("Tdel", "");
+	for(size_t i = 0; i < n; i++)
+		free(key[i]);
+	free(key);
+	fprintf(stderr, "%s: %zu raw values ok\n", progname, n);
+	return(0);
+}
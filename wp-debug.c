@@ -9,17 +9,18 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "Tbl.h"
 #include "wp.h"
 
 const char *
 dump_bitmap(Tbitmap w) {
-	static char buf[64*3];
+	static char buf[Tbitmapbits*3];
 	uint n = 0;
 	n += snprintf(buf+n, sizeof(buf)-n, "(");
-	for(uint i = 0; i < 64; i++) {
-		Tbitmap b = 1ULL << i;
+	for(uint i = 0; i < Tbitmapbits; i++) {
+		Tbitmap b = (Tbitmap)1 << i;
 		if(w & b)
 			n += snprintf(buf+n, sizeof(buf)-n, "%u,", i);
 	}
@@ -32,12 +33,12 @@ static void
 dump_rec(Trie *t, int d) {
 	if(isbranch(t)) {
 		printf("Tdump%*s branch %p %s %zu %d\n", d, "", t,
-		    dump_bitmap(t->branch.bitmap),
+		    dump_bitmap(twigmap(t)),
 		    (size_t)t->branch.index, t->branch.flags);
 		int dd = 2 + t->branch.index * 6 + t->branch.flags - 1;
 		assert(dd > d);
-		for(uint i = 0; i < 64; i++) {
-			Tbitmap b = 1ULL << i;
+		for(uint i = 0; i < Tbitmapbits; i++) {
+			Tbitmap b = (Tbitmap)1 << i;
 			if(hastwig(t, b)) {
 				printf("Tdump%*s twig %d\n", d, "", i);
 				dump_rec(twig(t, twigoff(t, b)), dd);
@@ -65,8 +66,11 @@ size_rec(Trie *t, uint d,
 	*rsize += sizeof(*t);
 	if(isbranch(t)) {
 		*rbranches += 1;
-		for(uint i = 0; i < 64; i++) {
-			Tbitmap b = 1ULL << i;
+		// Count unused capacity in the twig array as overhead.
+		uint m = popcount(twigmap(t));
+		*rsize += sizeof(*t) * (twigcap(m) - m);
+		for(uint i = 0; i < Tbitmapbits; i++) {
+			Tbitmap b = (Tbitmap)1 << i;
 			if(hastwig(t, b))
 				size_rec(twig(t, twigoff(t, b)),
 				    d+1, rsize, rdepth, rbranches, rleaves);
@@ -14,6 +14,7 @@
 #include "Tbl.h"
 #include "wp.h"
 
+Tclones
 bool
 Tgetkv(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
 	if(tbl == NULL)
@@ -26,13 +27,14 @@ Tgetkv(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
 			return(false);
 		t = twig(t, twigoff(t, b));
 	}
-	if(strcmp(key, t->leaf.key) != 0)
+	if(!leafmatch(t, key, len))
 		return(false);
 	*pkey = t->leaf.key;
 	*pval = t->leaf.val;
 	return(true);
 }
 
+Tclones
 static bool
 next_rec(Trie *t, const char **pkey, size_t *plen, void **pval) {
 	if(isbranch(t)) {
@@ -48,12 +50,12 @@ next_rec(Trie *t, const char **pkey, size_t *plen, void **pval) {
 	// We have found the next leaf.
 	if(*pkey == NULL) {
 		*pkey = t->leaf.key;
-		*plen = strlen(*pkey);
+		*plen = leaflen(t);
 		*pval = t->leaf.val;
 		return(true);
 	}
 	// We have found this leaf, so start looking for the next one.
-	if(strcmp(*pkey, t->leaf.key) == 0) {
+	if(leafmatch(t, *pkey, *plen)) {
 		*pkey = NULL;
 		*plen = 0;
 		return(false);
@@ -72,6 +74,25 @@ Tnextl(Tbl *tbl, const char **pkey, size_t *plen, void **pval) {
 	return(next_rec(&tbl->root, pkey, plen, pval));
 }
 
+static void
+free_rec(Trie *t) {
+	if(!isbranch(t))
+		return;
+	uint m = popcount(twigmap(t));
+	for(uint i = 0; i < m; i++)
+		free_rec(twig(t, i));
+	free(t->branch.twigs);
+}
+
+void
+Tfree(Tbl *tbl) {
+	if(tbl == NULL)
+		return;
+	free_rec(&tbl->root);
+	free(tbl);
+}
+
+Tclones
 Tbl *
 Tdelkv(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
 	if(tbl == NULL)
@@ -85,7 +106,7 @@ Tdelkv(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
 			return(tbl);
 		p = t; t = twig(t, twigoff(t, b));
 	}
-	if(strcmp(key, t->leaf.key) != 0)
+	if(!leafmatch(t, key, len))
 		return(tbl);
 	*pkey = t->leaf.key;
 	*pval = t->leaf.val;
@@ -103,26 +124,33 @@ Tdelkv(Tbl *tbl, const char *key, size_t len, const char **pkey, void **pval) {
 		return(tbl);
 	}
 	memmove(t->branch.twigs+s, t->branch.twigs+s+1, sizeof(Trie) * (m - s - 1));
-	t->branch.bitmap &= ~b;
+	twigmapset(t, twigmap(t) & ~b);
 	// We have now correctly removed the twig from the trie, so if
 	// realloc() fails we can ignore it and continue to use the
 	// slightly oversized twig array.
-	Trie *twigs = realloc(t->branch.twigs, sizeof(Trie) * (m - 1));
-	if(twigs != NULL) t->branch.twigs = twigs;
+	if(twigcap(m - 1) < twigcap(m)) {
+		Trie *twigs = realloc(t->branch.twigs,
+		    sizeof(Trie) * twigcap(m - 1));
+		if(twigs != NULL) t->branch.twigs = twigs;
+	}
 	return(tbl);
 }
 
+Tclones
 Tbl *
 Tsetl(Tbl *tbl, const char *key, size_t len, void *val) {
+	// Ensure the length fits in the leaf.
+	if((len >> Tlenbits) != 0) {
+		errno = EINVAL;
+		return(NULL);
+	}
 	if(val == NULL)
 		return(Tdell(tbl, key, len));
 	// First leaf in an empty tbl?
 	if(tbl == NULL) {
 		tbl = malloc(sizeof(*tbl));
 		if(tbl == NULL) return(NULL);
-		tbl->root.leaf.key = key;
-		tbl->root.leaf.val = val;
-		tbl->root.leaf.wasted = 0;
+		leafset(&tbl->root, key, len, val);
 		return(tbl);
 	}
 	Trie *t = &tbl->root;
@@ -144,6 +172,29 @@ Tsetl(Tbl *tbl, const char *key, size_t len, void *val) {
 	// Do the keys differ, and if so, where?
 	size_t i;
 	uint f;
+#ifdef HAVE_BINARY_KEYS
+	const char *tkey = t->leaf.key;
+	size_t tlen = t->leaf.len;
+	for(i = 0; i < len && i < tlen; i++) {
+		f = (byte)key[i] ^ (byte)tkey[i];
+		if(f != 0) goto newkey;
+	}
+	if(len == tlen) {
+		t->leaf.val = val;
+		return(tbl);
+	}
+newkey:; // We have the byte index; which chunk differs?
+	// See the comment in fp.c: we step forward from the chunk that
+	// contains the first bit of byte i. Note flags = shift | isbranch.
+	Tbitmap b1, b2;
+	for(size_t qi = i * 8 / 6 ;; qi++) {
+		i = qi * 6 / 8;
+		f = qi * 6 % 8 | 1;
+		b1 = keybit(key, len, i, f);
+		b2 = keybit(tkey, tlen, i, f);
+		if(b1 != b2) break;
+	}
+#else
 	for(i = 0; i <= len; i++) {
 		f = (byte)key[i] ^ (byte)t->leaf.key[i];
 		if(f != 0) goto newkey;
@@ -168,8 +219,11 @@ newkey:; // We have the branch's index; what are its flags?
 	k1 |= (k1 ? (byte)key[i+1] : 0);
 	k2 |= (k2 ? (byte)t->leaf.key[i+1] : 0);
 	Tbitmap b1 = nibbit(k1, f);
+	Tbitmap b2 = nibbit(k2, f);
+#endif
 	// Prepare the new leaf.
-	Trie t1 = { .leaf = { .key = key, .val = val, .wasted = 0 } };
+	Trie t1;
+	leafset(&t1, key, len, val);
 	// Find where to insert a branch or grow an existing branch.
 	t = &tbl->root;
 	while(isbranch(t)) {
@@ -188,22 +242,24 @@ newbranch:;
 	Trie *twigs = malloc(sizeof(Trie) * 2);
 	if(twigs == NULL) return(NULL);
 	Trie t2 = *t; // Save before overwriting.
-	Tbitmap b2 = nibbit(k2, f);
 	t->branch.twigs = twigs;
 	t->branch.flags = f;
 	t->branch.index = i;
-	t->branch.bitmap = b1 | b2;
+	twigmapset(t, b1 | b2);
 	*twig(t, twigoff(t, b1)) = t1;
 	*twig(t, twigoff(t, b2)) = t2;
 	return(tbl);
 growbranch:;
 	assert(!hastwig(t, b1));
 	uint s, m; TWIGOFFMAX(s, m, t, b1);
-	twigs = realloc(t->branch.twigs, sizeof(Trie) * (m + 1));
-	if(twigs == NULL) return(NULL);
+	twigs = t->branch.twigs;
+	if(twigcap(m + 1) > twigcap(m)) {
+		twigs = realloc(twigs, sizeof(Trie) * twigcap(m + 1));
+		if(twigs == NULL) return(NULL);
+	}
 	memmove(twigs+s+1, twigs+s, sizeof(Trie) * (m - s));
 	memmove(twigs+s, &t1, sizeof(Trie));
 	t->branch.twigs = twigs;
-	t->branch.bitmap |= b1;
+	twigmapset(t, twigmap(t) | b1);
 	return(tbl);
 }
@@ -11,21 +11,35 @@
 // instead of 4 bits, so the bitmap is 2^6 == 64 bits wide instead of
 // 2^4 == 16 bits wide. Trie nodes are three words instead of two words.
 //
-// These bigger nodes mean that (currently) space is wasted in the
-// leaf nodes. It might be possible to reclaim this space by embedding
-// (short) keys in the leaves - see notes-embed-key.md
+// These bigger nodes mean that leaves have a spare word, which holds
+// the key's length and a hash fingerprint; see below. It might also be
+// possible to use this space by embedding (short) keys in the leaves -
+// see notes-embed-key.md
 
 typedef unsigned char byte;
 typedef unsigned int uint;
 
+// With HAVE_BINARY_KEYS the bitmap has 65 bits: bit 0 is for the
+// end of the key, which is distinct from a '\0' byte, and the 6-bit
+// chunks are offset by one. There is no room for the extra bit in the
+// bitmap word, so it lives next to the flags and the index, and the
+// branch's whole bitmap is reassembled by twigmap(). The leaf uses its
+// spare word for the key's length. See the comments in qp.h.
+
+#ifdef HAVE_BINARY_KEYS
+typedef unsigned __int128 Tbitmap;
+#define Tbitmapbits 65
+#else
 typedef uint64_t Tbitmap;
+#define Tbitmapbits 64
+#endif
 
 const char *dump_bitmap(Tbitmap w);
 
 #if defined(HAVE_SLOW_POPCOUNT)
 
 static inline uint
-popcount(Tbitmap w) {
+popcount64(uint64_t w) {
 	const uint64_t m1 = 0x5555555555555555;
 	const uint64_t m2 = 0x3333333333333333;
 	const uint64_t m4 = 0x0F0F0F0F0F0F0F0F;
@@ -40,20 +54,62 @@ popcount(Tbitmap w) {
 #else
 
 static inline uint
-popcount(Tbitmap w) {
+popcount64(uint64_t w) {
 	return((uint)__builtin_popcountll(w));
 }
 
 #endif
 
+static inline uint
+popcount(Tbitmap w) {
+#ifdef HAVE_BINARY_KEYS
+	return(popcount64((uint64_t)w) + popcount64((uint64_t)(w >> 64)));
+#else
+	return(popcount64(w));
+#endif
+}
+
+// Runtime CPU dispatch, see qp.h.
+
+#ifdef HAVE_TARGET_CLONES
+#define Tclones __attribute__((target_clones("popcnt", "default")))
+#else
+#define Tclones
+#endif
+
+// The leaf's third word holds the key's length and a 32 bit hash of
+// the key, which are checked before the key itself, so that a lookup
+// that reaches the wrong leaf usually fails without a cache miss on
+// the leaf's key. Keys are limited to 2^28 - 1 bytes.
+
+#define Tlenbits 28
+
 typedef struct Tleaf {
 	const char *key;
 	void *val;
-	uint64_t wasted;
+	uint64_t zero : 4,
+	         len : Tlenbits,
+	         hash : 32;
 } Tleaf;
 
 // flags & 1 == isbranch
 // flags & 6 == shift
+//
+// The flags overlap the zero bits of the leaf's third word, so unlike
+// qp and fp there is no alignment restriction on the value; wp always
+// behaves as if HAVE_RAW_VALUES were defined.
+
+#ifdef HAVE_BINARY_KEYS
+
+typedef struct Tbranch {
+	union Trie *twigs;
+	uint64_t bitmap;
+	uint64_t flags : 3,
+	         end : 1,
+	         index : 60;
+} Tbranch;
+
+#else
 
 typedef struct Tbranch {
 	union Trie *twigs;
@@ -62,6 +118,8 @@ typedef struct Tbranch {
 	         index : 61;
 } Tbranch;
 
+#endif
+
 typedef union Trie {
 	struct Tleaf   leaf;
 	struct Tbranch branch;
@@ -102,27 +160,54 @@ isbranch(Trie *t) {
 static inline Tbitmap
 nibbit(uint k, uint flags) {
 	uint shift = 16 - 6 - (flags & 6);
+#ifdef HAVE_BINARY_KEYS
+	return((Tbitmap)2 << ((k >> shift) & 0x3FULL));
+#else
 	return(1ULL << ((k >> shift) & 0x3FULL));
+#endif
 }
 
 static inline Tbitmap
-twigbit(Trie *t, const char *key, size_t len) {
-	uint64_t i = t->branch.index;
+keybit(const char *key, size_t len, size_t i, uint flags) {
 	if(i >= len) return(1ULL);
 	uint k = (byte)key[i] << 8;
 	if(i+1 < len)
 		k |= (byte)key[i+1];
-	return(nibbit(k, t->branch.flags));
+	return(nibbit(k, flags));
+}
+
+static inline Tbitmap
+twigbit(Trie *t, const char *key, size_t len) {
+	return(keybit(key, len, t->branch.index, t->branch.flags));
+}
+
+static inline Tbitmap
+twigmap(Trie *t) {
+#ifdef HAVE_BINARY_KEYS
+	return((Tbitmap)t->branch.bitmap << 1 | t->branch.end);
+#else
+	return(t->branch.bitmap);
+#endif
+}
+
+static inline void
+twigmapset(Trie *t, Tbitmap map) {
+#ifdef HAVE_BINARY_KEYS
+	t->branch.bitmap = (uint64_t)(map >> 1);
+	t->branch.end = map & 1;
+#else
+	t->branch.bitmap = map;
+#endif
 }
 
 static inline bool
 hastwig(Trie *t, Tbitmap bit) {
-	return(t->branch.bitmap & bit);
+	return(twigmap(t) & bit);
 }
 
 static inline uint
 twigoff(Trie *t, Tbitmap b) {
-	return(popcount(t->branch.bitmap & (b-1ULL)));
+	return(popcount(twigmap(t) & (b-1)));
 }
 
 static inline Trie *
@@ -132,5 +217,65 @@ twig(Trie *t, uint i) {
 
 #define TWIGOFFMAX(off, max, t, b) do {			\
 		off = twigoff(t, b);			\
-		max = popcount(t->branch.bitmap);	\
+		max = popcount(twigmap(t));		\
 	} while(0)
+
+// See qp.h for a description of the TWIG_SLACK size classes.
+
+#ifndef TWIG_SLACK
+#define TWIG_SLACK 0
+#endif
+
+static inline uint
+twigcap(uint m) {
+#if TWIG_SLACK == 2
+	return(m <= 2 ? 2 : 1U << (32 - __builtin_clz(m - 1)));
+#elif TWIG_SLACK == 1
+	return((m + 1) & ~1U);
+#else
+	return(m);
+#endif
+}
+
+// A cheap word-at-a-time hash for the leaf fingerprint. The query
+// key is already in the cache, so this is much faster than a miss.
+
+static inline uint32_t
+keyhash(const char *key, size_t len) {
+	const uint64_t m = 0x9E3779B97F4A7C15ULL;
+	uint64_t h = len * m, w;
+	for(; len >= 8; key += 8, len -= 8) {
+		memcpy(&w, key, 8);
+		h = (h ^ w) * m;
+		h ^= h >> 29;
+	}
+	w = 0;
+	memcpy(&w, key, len);
+	h = (h ^ w) * m;
+	h ^= h >> 32;
+	return((uint32_t)h);
+}
+
+static inline void
+leafset(Trie *t, const char *key, size_t len, void *val) {
+	t->leaf.key = key;
+	t->leaf.val = val;
+	t->leaf.zero = 0;
+	t->leaf.len = len;
+	t->leaf.hash = keyhash(key, len);
+}
+
+static inline size_t
+leaflen(Trie *t) {
+	return(t->leaf.len);
+}
+
+// Without HAVE_BINARY_KEYS we rely on the length being correct, as
+// keybit() does, so the '\0' terminators need not be compared.
+
+static inline bool
+leafmatch(Trie *t, const char *key, size_t len) {
+	return(len == t->leaf.len &&
+	       keyhash(key, len) == t->leaf.hash &&
+	       memcmp(key, t->leaf.key, len) == 0);
+}